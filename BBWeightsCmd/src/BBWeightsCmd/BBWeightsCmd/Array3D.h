@@ -2,6 +2,8 @@
 #define __ARRAY3D_H
 
 #include "EIGEN_inc.h"
+#include <vector>
+#include <stdint.h>
 
 // Minimal encapsulation for a 3D array, mostly for indexing and asserts
 template<class T> class Array3D {
@@ -79,4 +81,86 @@ protected:
 
 };
 
-#endif
\ No newline at end of file
+// Bit-packed specialization used for voxel occupancy: one bit per voxel, so the memory no longer limits the
+// resolution (512^3 voxels take 16MB). Every (y, z) row of x values starts on its own 64-bit word, so rows can
+// be written from different threads. Bits cannot be referenced: writes go through set().
+template<> class Array3D<bool> {
+
+public:
+	Array3D() {
+		m_size = Vector3i::Zero();
+		m_rowWords = 0;
+	}
+	Array3D(int xSize, int ySize, int zSize) {
+		init(xSize, ySize, zSize);
+	}
+
+	void init(int xSize, int ySize, int zSize) {
+		assert(xSize >= 0 && ySize >= 0 && zSize >= 0);
+		m_size = Vector3i(xSize, ySize, zSize);
+		m_rowWords = (xSize + 63) / 64;
+		m_bits.assign((size_t)m_rowWords * ySize * zSize, 0);
+	}
+
+	void free() {
+		m_bits.clear();
+		m_size = Vector3i::Zero();
+		m_rowWords = 0;
+	}
+
+	bool validIndices(int x, int y, int z) const {
+		return (x >= 0 && x < (int)m_size[0] && y >= 0 && y < (int)m_size[1] && z >= 0 && z < (int)m_size[2]);
+	}
+
+	bool operator()(int x, int y, int z) const {
+		assert(validIndices(x, y, z));
+		return ((m_bits[wordIndex(x, y, z)] >> (x & 63)) & 1) != 0;
+	}
+
+	void set(int x, int y, int z, bool val) {
+		assert(validIndices(x, y, z));
+		const uint64_t mask = (uint64_t)1 << (x & 63);
+		if (val) m_bits[wordIndex(x, y, z)] |= mask;
+		else m_bits[wordIndex(x, y, z)] &= ~mask;
+	}
+
+	int getSize(int c) const {
+		return m_size[c];
+	}
+
+	void setAllTo(bool cVal) {
+		std::fill(m_bits.begin(), m_bits.end(), (uint64_t)0);
+		if (cVal) {
+			for (int z = 0; z < m_size[2]; z++)
+				for (int y = 0; y < m_size[1]; y++)
+					for (int x = 0; x < m_size[0]; x++) set(x, y, z, true);
+		}
+	}
+
+	// number of set voxels
+	size_t count() const {
+		size_t cnt = 0;
+		for (size_t i = 0; i < m_bits.size(); i++) {
+			uint64_t w = m_bits[i];
+			for (; w; cnt++) w &= w - 1;
+		}
+		return cnt;
+	}
+
+	// raw access to the words of a (y, z) row, bit x & 63 of word x / 64 is voxel x
+	int getRowWords() const { return m_rowWords; }
+	const uint64_t * row(int y, int z) const { return &m_bits[((size_t)z * m_size[1] + y) * m_rowWords]; }
+	uint64_t * row(int y, int z) { return &m_bits[((size_t)z * m_size[1] + y) * m_rowWords]; }
+
+protected:
+	size_t wordIndex(int x, int y, int z) const {
+		return ((size_t)z * m_size[1] + y) * m_rowWords + (x >> 6);
+	}
+
+	Vector3i m_size; // x, y, z dimensions
+	int m_rowWords; // 64-bit words per row
+	std::vector<uint64_t> m_bits;
+
+};
+
+#endif
@@ -11,15 +11,79 @@ static const char *kTargetMeshLong = "-targetMesh";
 static const char *kTargetBone = "-tb";
 static const char *kTargetBoneong = "-targetBone";
 
+static const char *kHandleThreads = "-ht";
+static const char *kHandleThreadsLong = "-handleThreads";
+
+static const char *kSolverThreads = "-st";
+static const char *kSolverThreadsLong = "-solverThreads";
+
+static const char *kSolver = "-sv";
+static const char *kSolverLong = "-solver";
+
+static const char *kVoxelizer = "-vx";
+static const char *kVoxelizerLong = "-voxelizer";
+
+static const char *kBenchmark = "-bm";
+static const char *kBenchmarkLong = "-benchmark";
+
+static const char *kAdaptive = "-ad";
+static const char *kAdaptiveLong = "-adaptive";
+
+static const char *kMaxInfluences = "-mi";
+static const char *kMaxInfluencesLong = "-maxInfluences";
+
+static const char *kPruneWeight = "-pw";
+static const char *kPruneWeightLong = "-pruneWeight";
+
+static const char *kCache = "-ca";
+static const char *kCacheLong = "-cache";
+
+static const char *kIncremental = "-in";
+static const char *kIncrementalLong = "-incremental";
+
+static const char *kGridCache = "-gc";
+static const char *kGridCacheLong = "-gridCache";
+
+static const char *kProfile = "-pf";
+static const char *kProfileLong = "-profile";
+
+static const char *kCascade = "-cs";
+static const char *kCascadeLong = "-cascade";
+
+static const char *kMortonOrder = "-mo";
+static const char *kMortonOrderLong = "-mortonOrder";
+
+// grids kept between invocations, keyed by computeMeshKey
+static GridCache s_gridCache;
+
 
 BBWeightsCmd::BBWeightsCmd()
 {
 	_isTargetJointProvided = false;
 	_isTargetMeshProvided = false;
+	_createdSkin = false;
+	_handleThreads = 1;
+	_solverThreads = 4;
+	_solverName = defaultQPinterface();
+	_benchmark = false;
+	_adaptiveLevels = 0;
+	_maxInfluences = 0;
+	_pruneWeight = 0;
+	_cacheHit = false;
+	_incremental = false;
+	_gridCacheSize = -1;
+	_profiling = false;
+	_cascadeLevels = 0;
+	_mortonOrder = false;
+	vox_res = 64;
+	voxGrid = 0;
+	_ownsGrid = false;
+	_cpuVoxelizer = true; // the voxels of the bbw tool; -voxelizer gl opts in to the GL path
 }
 
 BBWeightsCmd::~BBWeightsCmd()
 {
+	if (_ownsGrid) delete voxGrid;
 	_boneDagPaths.clear();
 }
 
@@ -29,6 +93,20 @@ MSyntax BBWeightsCmd::newSyntax()
 	syntax.addFlag(kVoxResolution, kVoxResolutionLong, MSyntax::kLong);
 	syntax.addFlag(kTargetMesh, kTargetMeshLong, MSyntax::kString);
 	syntax.addFlag(kTargetBone, kTargetBoneong, MSyntax::kString);
+	syntax.addFlag(kHandleThreads, kHandleThreadsLong, MSyntax::kLong);
+	syntax.addFlag(kSolverThreads, kSolverThreadsLong, MSyntax::kLong);
+	syntax.addFlag(kSolver, kSolverLong, MSyntax::kString);
+	syntax.addFlag(kVoxelizer, kVoxelizerLong, MSyntax::kString);
+	syntax.addFlag(kBenchmark, kBenchmarkLong, MSyntax::kBoolean);
+	syntax.addFlag(kAdaptive, kAdaptiveLong, MSyntax::kLong);
+	syntax.addFlag(kMaxInfluences, kMaxInfluencesLong, MSyntax::kLong);
+	syntax.addFlag(kPruneWeight, kPruneWeightLong, MSyntax::kDouble);
+	syntax.addFlag(kCache, kCacheLong, MSyntax::kString);
+	syntax.addFlag(kIncremental, kIncrementalLong, MSyntax::kBoolean);
+	syntax.addFlag(kGridCache, kGridCacheLong, MSyntax::kLong);
+	syntax.addFlag(kProfile, kProfileLong, MSyntax::kBoolean);
+	syntax.addFlag(kCascade, kCascadeLong, MSyntax::kLong);
+	syntax.addFlag(kMortonOrder, kMortonOrderLong, MSyntax::kBoolean);
 
 	syntax.enableQuery(false);
 	syntax.enableEdit(false);
@@ -117,6 +195,92 @@ MStatus BBWeightsCmd::parseArgs(const MArgList &args)
 	{
 		stat = argData.getFlagArgument(kVoxResolution, 0, vox_res);
 	}
+	// handle-level parallelism: 1 = serial (default), 0 = as many handles as the cores allow
+	if (argData.isFlagSet(kHandleThreads))
+	{
+		stat = argData.getFlagArgument(kHandleThreads, 0, _handleThreads);
+	}
+	if (argData.isFlagSet(kSolverThreads))
+	{
+		stat = argData.getFlagArgument(kSolverThreads, 0, _solverThreads);
+	}
+	if (argData.isFlagSet(kSolver))
+	{
+		MString solverName;
+		stat = argData.getFlagArgument(kSolver, 0, solverName);
+		QPinterface * qp = createQPinterface(solverName.asChar());
+		if (qp == NULL) {
+			MGlobal::displayError(solverName + " isn't a known QP solver.");
+			return MS::kFailure;
+		}
+		delete qp;
+		_solverName = solverName.asChar();
+	}
+	if (argData.isFlagSet(kVoxelizer))
+	{
+		MString voxelizer;
+		stat = argData.getFlagArgument(kVoxelizer, 0, voxelizer);
+		if (voxelizer != "cpu" && voxelizer != "gl") {
+			MGlobal::displayError(voxelizer + " isn't a known voxelizer (cpu or gl).");
+			return MS::kFailure;
+		}
+		_cpuVoxelizer = (voxelizer == "cpu");
+	}
+	if (argData.isFlagSet(kBenchmark))
+	{
+		stat = argData.getFlagArgument(kBenchmark, 0, _benchmark);
+	}
+	if (argData.isFlagSet(kAdaptive))
+	{
+		stat = argData.getFlagArgument(kAdaptive, 0, _adaptiveLevels);
+		if (_adaptiveLevels < 0) _adaptiveLevels = 0;
+	}
+	if (argData.isFlagSet(kMaxInfluences))
+	{
+		stat = argData.getFlagArgument(kMaxInfluences, 0, _maxInfluences);
+	}
+	if (argData.isFlagSet(kPruneWeight))
+	{
+		stat = argData.getFlagArgument(kPruneWeight, 0, _pruneWeight);
+	}
+	if (argData.isFlagSet(kCache))
+	{
+		MString cacheFile;
+		stat = argData.getFlagArgument(kCache, 0, cacheFile);
+		_cacheFile = cacheFile.asChar();
+	}
+	if (argData.isFlagSet(kIncremental))
+	{
+		stat = argData.getFlagArgument(kIncremental, 0, _incremental);
+	}
+	if (argData.isFlagSet(kGridCache))
+	{
+		stat = argData.getFlagArgument(kGridCache, 0, _gridCacheSize);
+	}
+	if (argData.isFlagSet(kProfile))
+	{
+		stat = argData.getFlagArgument(kProfile, 0, _profiling);
+	}
+	if (argData.isFlagSet(kCascade))
+	{
+		stat = argData.getFlagArgument(kCascade, 0, _cascadeLevels);
+	}
+	if (argData.isFlagSet(kMortonOrder))
+	{
+		stat = argData.getFlagArgument(kMortonOrder, 0, _mortonOrder);
+	}
+	// the effective voxelizer, before it goes into the grid and cache keys
+	if (!_cpuVoxelizer && vox_res > 128) {
+		MGlobal::displayWarning("The GL voxelizer is limited to 128 voxels, using the CPU voxelizer.");
+		_cpuVoxelizer = true;
+	}
+	if (!_cpuVoxelizer && MGlobal::mayaState() != MGlobal::kInteractive) {
+		MGlobal::displayWarning("No GL context in batch mode, using the CPU voxelizer.");
+		_cpuVoxelizer = true;
+	}
+	vector<string> warnings;
+	CheckGridOptions(_adaptiveLevels, _solverName, _cascadeLevels, _mortonOrder, warnings);
+	for (size_t i = 0; i < warnings.size(); i++) MGlobal::displayWarning(MString(warnings[i].c_str()));
 	return stat;
 }
 
@@ -126,17 +290,67 @@ MStatus BBWeightsCmd::doIt(const MArgList &args)
 	MTimer timer; timer.beginTimer();
 	stat = parseArgs(args);
 	if (MFAIL(stat)) return stat;
+	_profile.clear();
+	BBWProfile * profile = _profiling ? &_profile : NULL;
 
-	preprocessing();
-
-	// solve
-	compute(*voxGrid, B, boneWise);
-	for (int i = 0; i < vertices.size(); i++)
 	{
-		voxGrid->getInterpolatedBBW(vertices.row(i), weights[i], _numberOfBones);
+		BBWProfile::Scope scope(profile, "preprocessing");
+		preprocessing();
 	}
 
-	postprocessing();
+	int emptyRows;
+	if (_cacheHit) {
+		// weights used in place from the mapped file
+		const BBWCacheHeader & header = _cache.header();
+		BBWProfile::Scope scope(profile, "influences");
+		emptyRows = sparseWeights.build(_cache.vertexWeights(), header.numVertices, header.numBones, _maxInfluences, _pruneWeight);
+		_cache.close();
+		cout << "BBW Solver: weights read from " << _cacheFile << endl;
+	}
+	else {
+		// solve
+		voxGrid->setSolverThreads(_handleThreads, _solverThreads);
+		if (_benchmark) {
+			benchmarkAssembly();
+			benchmarkSolvers(*voxGrid, B, boneWise);
+		}
+		voxGrid->setSolver(_solverName);
+		voxGrid->setCascade(_cascadeLevels);
+		voxGrid->setProfile(profile);
+		if (_incremental && !voxGrid->hasIncrementalState()) {
+			MGlobal::displayWarning("No previous solve kept for this mesh and solver (first run, grid not kept with -gridCache 0 or evicted): solving all the handles.");
+		}
+		bool solved;
+		{
+			BBWProfile::Scope scope(profile, "solve");
+			solved = compute(*voxGrid, B, boneWise);
+		}
+		voxGrid->setProfile(NULL);
+		// nothing cached nor bound from a failed solve
+		if (!solved) {
+			MGlobal::displayError("The BBW solve failed, the skinCluster is left unchanged.");
+			return MS::kFailure;
+		}
+		if (_incremental) cout << "BBW Solver: " << voxGrid->getNumSolvedHandles() << " handles solved" << endl;
+		int outside;
+		{
+			BBWProfile::Scope scope(profile, "interpolation");
+			outside = voxGrid->getInterpolatedBBW(vertices, weights, _numberOfBones);
+		}
+		if (!_cacheFile.empty() && outside == 0) {
+			BBWProfile::Scope scope(profile, "cacheExport");
+			voxGrid->exportBBW(_cacheFile, _cacheKey, weights);
+		}
+		BBWProfile::Scope scope(profile, "influences");
+		emptyRows = sparseWeights.build(weights, _maxInfluences, _pruneWeight);
+	}
+	if (emptyRows > 0) MGlobal::displayWarning(MString() + emptyRows + " vertices have no positive weight and are left without influence.");
+
+	{
+		BBWProfile::Scope scope(profile, "skinCluster");
+		stat = postprocessing();
+	}
+	if (_profiling) setResult(MString(_profile.toJSON().c_str()));
 
 	timer.endTimer();
 
@@ -151,25 +365,101 @@ MStatus BBWeightsCmd::preprocessing()
 	/*mesh*/
 	vertices.resize(_numVertices, 3);
 	UnitPacking(_fnTargetMesh, vertices, bmin, bmax, scale, center);
-	weights.resize(_numVertices);
-	/*voxelize*/
-	m_voxArray.init(vox_res, vox_res, vox_res);
-	m_voxArray.setAllTo(-1);
-	Voxelize(_fnTargetMesh, vox_res, vox_res, vox_res, voxels, m_voxArray);
 	/*skeleton*/
+	B.clear();
+	boneWise.clear();
 	ReadJointHeirarchy(_fnTargetJoint);
 	_numberOfBones = B.size();
-	if (voxGrid != 0){ delete voxGrid; voxGrid = 0; }
-	voxGrid = new BoxGrid();
-	voxGrid->initVoxels(vox_res, m_voxArray);
-	voxGrid->initStructure();
+	/*cache*/
+	_cacheHit = false;
+	if (!_cacheFile.empty()) {
+		_cacheKey = computeCacheKey();
+		_cacheHit = _cache.open(_cacheFile, _cacheKey) && _cache.header().numVertices == (int)_numVertices
+			&& _cache.header().numBones == (int)_numberOfBones;
+		if (_cacheHit) return stat;
+		_cache.close();
+	}
+	/*grid*/
+	if (_gridCacheSize >= 0) s_gridCache.setCapacity(_gridCacheSize);
+	const uint64_t meshKey = computeMeshKey();
+	vector<RowVector3> refinementPoints;
+	if (_adaptiveLevels > 0) BoneRefinementPoints(B, boneWise, refinementPoints);
+	voxGrid = s_gridCache.find(meshKey);
+	if (voxGrid != 0) {
+		cout << "BBW Solver: reusing the grid of the same mesh." << endl;
+		// the octree follows the skeleton: rebuilt from the voxels it keeps
+		OctreeGrid * octree = dynamic_cast<OctreeGrid *>(voxGrid);
+		if (octree != NULL && octree->getRefinementPoints() != refinementPoints) {
+			BBWProfile::Scope scope(_profiling ? &_profile : NULL, "gridBuild");
+			octree->setRefinementPoints(refinementPoints);
+			octree->clearIncremental();
+			octree->initStructure();
+		}
+	}
+	else {
+		/*voxelize*/
+		m_voxArray.init(vox_res, vox_res, vox_res);
+		if (_benchmark) benchmarkVoxelizers(_fnTargetMesh, vox_res);
+		{
+			BBWProfile::Scope scope(_profiling ? &_profile : NULL, "voxelization");
+			if (_cpuVoxelizer) VoxelizePacked(_fnTargetMesh, vertices, vox_res, m_voxArray);
+			else Voxelize(_fnTargetMesh, vox_res, vox_res, vox_res, voxels, m_voxArray);
+		}
+		BBWProfile::Scope scope(_profiling ? &_profile : NULL, "gridBuild");
+		voxGrid = CreateGrid(vox_res, m_voxArray, _adaptiveLevels, refinementPoints);
+		voxGrid->setMortonOrder(_mortonOrder);
+		voxGrid->initStructure();
+		m_voxArray.free();
+		_ownsGrid = !s_gridCache.insert(meshKey, voxGrid);
+	}
+	voxGrid->setIncremental(_incremental);
 	cout << "BBW Solver: Initialization Done." << endl;
 	return stat;
 }
 
+// what the grid depends on: mesh geometry and topology, resolution, voxelizer and domain options
+uint64_t BBWeightsCmd::computeMeshKey() const
+{
+	uint64_t h = hashFNV1a(vertices.data(), vertices.size() * sizeof(ScalarType));
+	h = hashFNV1a(&scale, sizeof(scale), h);
+	h = hashFNV1a(center.data(), 3 * sizeof(ScalarType), h);
+	MIntArray triangleCounts, triangleVertices;
+	_fnTargetMesh.getTriangles(triangleCounts, triangleVertices);
+	for (unsigned int i = 0; i < triangleVertices.length(); ++i) {
+		const int v = triangleVertices[i];
+		h = hashFNV1a(&v, sizeof(v), h);
+	}
+	const int options[4] = { (int)vox_res, _adaptiveLevels, (int)_mortonOrder, (int)_cpuVoxelizer };
+	return hashFNV1a(options, sizeof(options), h);
+}
+
+// everything the weights depend on: the grid and the skeleton
+uint64_t BBWeightsCmd::computeCacheKey() const
+{
+	uint64_t h = computeMeshKey();
+	for (map<string, RowVector3>::const_iterator it = B.begin(); it != B.end(); ++it) {
+		h = hashFNV1a(it->first.c_str(), it->first.size() + 1, h);
+		h = hashFNV1a(it->second.data(), 3 * sizeof(ScalarType), h);
+	}
+	for (map<string, string>::const_iterator it = boneWise.begin(); it != boneWise.end(); ++it) {
+		h = hashFNV1a(it->first.c_str(), it->first.size() + 1, h);
+		h = hashFNV1a(it->second.c_str(), it->second.size() + 1, h);
+	}
+	return h;
+}
+
+void BBWeightsCmd::releaseGridCache()
+{
+	s_gridCache.clear();
+}
+
 MStatus BBWeightsCmd::postprocessing()
 {
 	MStatus stat;
+	stat = applySkinCluster();
+	if (MFAIL(stat)) return stat;
+	stat = applySkinWeights();
+	if (MFAIL(stat)) MGlobal::displayError("Couldn't set the skin weights.");
 	return stat;
 }
 MStatus BBWeightsCmd::ReadJointHeirarchy(const MFnIkJoint& _fnJoint)
@@ -192,59 +482,88 @@ MStatus BBWeightsCmd::applySkinCluster()
 {
 	MStatus stat;
 
-	// Construct commands
-	MString meshName = _fnTargetMesh.partialPathName();
-	stringstream cmdStr;
-	cmdStr << "skinCluster -tsb -nw 1 ";
-	for (unsigned int i = 0; i < _numberOfBones; ++i)
-		cmdStr << _boneDagPaths[i].partialPathName().asChar() << " ";
+	_meshDagPath = _fnTargetMesh.dagPath();
+	_meshDagPath.extendToShape();
+	// the weight columns follow the order of B
+	_boneDagPaths.clear();
+	for (map<string, RowVector3>::const_iterator it = B.begin(); it != B.end(); ++it)
+		_boneDagPaths.append(getDagPath(it->first.c_str()));
 
-	cmdStr << " " << meshName.asChar() << ";";
+	// Construct commands: bind a new skinCluster, or add the missing joints to the existing one
+	MObject skinNode = getSkinNode(_meshDagPath, &stat);
+	_createdSkin = skinNode.isNull();
+	stringstream cmdStr;
+	if (_createdSkin) {
+		cmdStr << "skinCluster -tsb -nw 1 ";
+		if (_maxInfluences > 0) cmdStr << "-mi " << _maxInfluences << " ";
+		for (unsigned int i = 0; i < _boneDagPaths.length(); ++i)
+			cmdStr << _boneDagPaths[i].partialPathName().asChar() << " ";
+		cmdStr << " " << _meshDagPath.partialPathName().asChar() << ";";
+	}
+	else {
+		_fnSKin.setObject(skinNode);
+		MDagPathArray infObjs;
+		_fnSKin.influenceObjects(infObjs);
+		for (unsigned int i = 0; i < _boneDagPaths.length(); ++i) {
+			bool found = false;
+			for (unsigned int k = 0; k < infObjs.length() && !found; ++k) found = (infObjs[k] == _boneDagPaths[i]);
+			if (!found) cmdStr << "skinCluster -e -wt 0 -ai " << _boneDagPaths[i].partialPathName().asChar() << " " << _fnSKin.name().asChar() << ";";
+		}
+	}
 
 	// Execute commands
-	_dagMod.commandToExecute(cmdStr.str().c_str());
-	_dagMod.doIt();
-
-	MObject skinNode = getSkinNode(_fnTargetMesh.dagPath(), &stat);
-	_fnTargetMesh.setObject(skinNode);
+	if (!cmdStr.str().empty()) {
+		_dagMod.commandToExecute(cmdStr.str().c_str());
+		stat = _dagMod.doIt();
+		if (MFAIL(stat)) {
+			MGlobal::displayError("Couldn't bind the skinCluster.");
+			return stat;
+		}
+	}
 
-	return stat;
+	skinNode = getSkinNode(_meshDagPath, &stat);
+	if (skinNode.isNull()) {
+		MGlobal::displayError("No skinCluster on " + _meshDagPath.partialPathName());
+		return MS::kFailure;
+	}
+	return _fnSKin.setObject(skinNode);
 }
 
+// every vertex and every influence in a single setWeights call
 MStatus BBWeightsCmd::applySkinWeights()
 {
 	MStatus stat;
 
-	MSelectionList compList;
+	// influence of each weight column (influences that aren't bones of the skeleton get a zero weight)
 	MDagPathArray infObjs;
-
-	// Get component list
-	unsigned int count = _fnSKin.influenceObjects(infObjs);
-	for (unsigned int i = 0; i < count; ++i) {
+	unsigned int numInfluences = _fnSKin.influenceObjects(infObjs, &stat);
+	vector<int> columnInfluence(_numberOfBones, -1);
+	_infIds.clear();
+	for (unsigned int i = 0; i < numInfluences; ++i) {
 		_infIds.append(i);
-		MSelectionList selList;
-		MDoubleArray tmp;
-		stat = _fnSKin.getPointsAffectedByInfluence(infObjs[i], selList, tmp);
-		stat = compList.merge(selList);
+		for (unsigned int j = 0; j < _boneDagPaths.length(); ++j)
+			if (infObjs[i] == _boneDagPaths[j]) columnInfluence[j] = i;
 	}
 
-	// Get component object
-	stat = compList.getDagPath(0, _meshDagPath, _meshComps);
-
-	// Store old weights
-	stat = _fnSKin.getWeights(_meshDagPath, _meshComps, _infIds, _oldWeightValues);
-
-	// Copy weights from eigen matrix to MDoubleArray
-	//W.transposeInPlace();
-	//double *weightArray = new double[W.size()];
-	//Map<MatrixXd>(weightArray, W.rows(), W.cols()) = W;
-	//MDoubleArray weights(weightArray, (unsigned int)W.size());
-	//_newWeightValues.copy(weights);
-	//delete[] weightArray;
+	// Get component object: all the vertices
+	MFnSingleIndexedComponent fnComps;
+	_meshComps = fnComps.create(MFn::kMeshVertComponent, &stat);
+	fnComps.setCompleteData((int)_numVertices);
+
+	// Scatter the kept influences into a vertex-major buffer, copied once into the MDoubleArray
+	vector<double> values((size_t)_numVertices * numInfluences, 0.0);
+#pragma omp parallel for
+	for (int v = 0; v < (int)_numVertices; ++v) {
+		for (int k = sparseWeights.offsets[v]; k < sparseWeights.offsets[v + 1]; ++k) {
+			const int i = columnInfluence[sparseWeights.influences[k]];
+			if (i != -1) values[(size_t)v * numInfluences + i] = sparseWeights.weights[k];
+		}
+	}
+	_newWeightValues = MDoubleArray(values.empty() ? NULL : &values[0], (unsigned int)values.size());
 
-	// Set weights
+	// Set weights, keeping the old ones for undo
 	stat = _fnSKin.setWeights(_meshDagPath, _meshComps, _infIds,
-		_newWeightValues, true, &_oldWeightValues);
+		_newWeightValues, false, &_oldWeightValues);
 
 	return stat;
 }
@@ -252,31 +571,19 @@ MStatus BBWeightsCmd::applySkinWeights()
 MStatus BBWeightsCmd::undoIt()
 {
 	MStatus stat;
-	if (_isTargetJointProvided) {
-		if (_isTargetMeshProvided) stat = _dagMod.undoIt();
-		else stat = _fnSKin.setWeights(_meshDagPath, _meshComps, _infIds,
-			_oldWeightValues, true, &_newWeightValues);
-	}
-	else {
-		stat = _dagMod.undoIt();
-		stat = _fnSKin.setWeights(_meshDagPath, _meshComps, _infIds,
-			_oldWeightValues, true, &_newWeightValues);
-	}
+	// a skinCluster we created goes away with the modifier, an existing one gets its weights back
+	if (!_createdSkin) stat = _fnSKin.setWeights(_meshDagPath, _meshComps, _infIds, _oldWeightValues, false);
+	stat = _dagMod.undoIt();
 	return stat;
 }
 
 MStatus BBWeightsCmd::redoIt()
 {
 	MStatus stat;
-	if (_isTargetJointProvided) {
-		if (_isTargetMeshProvided) stat = _dagMod.doIt();
-		else stat = _fnSKin.setWeights(_meshDagPath, _meshComps, _infIds,
-			_newWeightValues, true, &_oldWeightValues);
-	}
-	else {
-		stat = _dagMod.doIt();
-		_fnSKin.setWeights(_meshDagPath, _meshComps, _infIds,
-			_newWeightValues, true, &_oldWeightValues);
-	}
+	stat = _dagMod.doIt();
+	MObject skinNode = getSkinNode(_meshDagPath, &stat);
+	if (skinNode.isNull()) return MS::kFailure;
+	_fnSKin.setObject(skinNode);
+	stat = _fnSKin.setWeights(_meshDagPath, _meshComps, _infIds, _newWeightValues, false);
 	return stat;
-}
\ No newline at end of file
+}
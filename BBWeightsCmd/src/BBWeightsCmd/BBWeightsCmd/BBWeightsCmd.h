@@ -5,6 +5,8 @@
 #include "Array3D.h"
 #include "STL_inc.h"
 #include "BoxGrid.h"
+#include "OctreeGrid.h"
+#include "grid_cache.h"
 #include "Weights.h"
 
 
@@ -19,6 +21,8 @@ public:
 	virtual bool isUndoable() const;
 	static void* creator();
 	static MSyntax newSyntax();
+	// frees the grids kept between invocations (plugin unload)
+	static void releaseGridCache();
 
 private:
 	MStatus parseArgs(const MArgList &args);
@@ -30,12 +34,32 @@ private:
 	MStatus applySkinWeights();
 
 	MStatus ReadJointHeirarchy(const MFnIkJoint& _fnJoint);
+	uint64_t computeMeshKey() const;
+	uint64_t computeCacheKey() const;
 
 
 	unsigned int vox_res;
+	int _handleThreads, _solverThreads;
+	string _solverName;
+	bool _benchmark;
+	int _adaptiveLevels; // 0: uniform grid
+	bool _cpuVoxelizer;
 	bool _isTargetJointProvided;
 	bool _isTargetMeshProvided;
-	size_t _numVertices, _numberOfBones, _maxInfluences;
+	bool _createdSkin; // the skinCluster was created by the command (else an existing one is reused)
+	size_t _numVertices, _numberOfBones;
+	int _maxInfluences; // 0: all the bones
+	double _pruneWeight; // influences below are dropped
+	string _cacheFile; // empty: no cache
+	uint64_t _cacheKey;
+	bool _cacheHit;
+	BBWCache _cache;
+	bool _incremental; // keep the solutions for the next invocation on the same mesh
+	int _gridCacheSize; // grids kept between invocations, -1: unchanged
+	bool _profiling; // per-stage timings and memory returned as JSON
+	BBWProfile _profile;
+	int _cascadeLevels; // coarser grids solved first to warm start the solve
+	bool _mortonOrder; // grid numbered along the Morton curve
 
 	MFnMesh _fnTargetMesh;
 	MFnIkJoint _fnTargetJoint;
@@ -48,15 +72,17 @@ private:
 	MDagModifier _dagMod;
 
 	MPointArray voxels;
-	Array3D<int> m_voxArray;
+	Array3D<bool> m_voxArray;
 	map<string, RowVector3> B;
 	map<string, string> boneWise;
 	RowVector3 bmin, bmax;
 	ScalarType scale;
 	RowVector3 center;
 	PointMatrixType vertices;
-	BoxGrid * voxGrid;
-	vector<Weights> weights;
+	BoxGrid * voxGrid; // owned by the grid cache, unless _ownsGrid
+	bool _ownsGrid;
+	RowMatrixXX weights; // numVertices x numberOfBones
+	SparseWeights sparseWeights; // the influences kept per vertex
 };
 
 #endif
@@ -1,7 +1,76 @@
 #include "BoxGrid.h"
-#include "MOSEK_solver.h" // QP solver (Mosek library)
+#include "qp_solver.h" // QP solvers (Mosek library or built-in active set)
+#include <omp.h>
 
-void BoxGrid::initVoxels(const int res, Array3D<int>& m_voxArray) {
+// numbers the set entries of occupancy in x, y, z loop order (z fastest), the others get -1. The arrays are
+// swept in memory order (x fastest), one y per thread: the entries of each (x, y) column are counted, a prefix
+// sum over the columns in x, y order gives the first id of each column, then each column is numbered along z.
+static int numberOccupied(const Array3D<bool> & occupancy, Array3D<int> & ids)
+{
+	const int Xs = occupancy.getSize(0), Ys = occupancy.getSize(1), Zs = occupancy.getSize(2);
+	ids.init(Xs, Ys, Zs);
+	vector<int> columns((size_t)Xs * Ys, 0); // entry of column (x, y) at y * Xs + x
+#pragma omp parallel for
+	for (int y = 0; y < Ys; y++) {
+		int * count = &columns[(size_t)y * Xs];
+		for (int z = 0; z < Zs; z++) {
+			const uint64_t * row = occupancy.row(y, z);
+			for (int x = 0; x < Xs; x++) count[x] += (row[x >> 6] >> (x & 63)) & 1;
+		}
+	}
+	vector<int> slabs(Xs + 1, 0);
+#pragma omp parallel for
+	for (int x = 0; x < Xs; x++) {
+		int n = 0;
+		for (int y = 0; y < Ys; y++) n += columns[(size_t)y * Xs + x];
+		slabs[x + 1] = n;
+	}
+	for (int x = 0; x < Xs; x++) slabs[x + 1] += slabs[x];
+#pragma omp parallel for
+	for (int x = 0; x < Xs; x++) {
+		int id = slabs[x];
+		for (int y = 0; y < Ys; y++) {
+			const int n = columns[(size_t)y * Xs + x];
+			columns[(size_t)y * Xs + x] = id;
+			id += n;
+		}
+	}
+#pragma omp parallel for
+	for (int y = 0; y < Ys; y++) {
+		int * next = &columns[(size_t)y * Xs];
+		for (int z = 0; z < Zs; z++) {
+			const uint64_t * row = occupancy.row(y, z);
+			for (int x = 0; x < Xs; x++) ids(x, y, z) = ((row[x >> 6] >> (x & 63)) & 1) ? next[x]++ : -1;
+		}
+	}
+	return slabs[Xs];
+}
+// a node is used if one of the (up to 8) boxes x-1..x, y-1..y, z-1..z is occupied: each row of nodes is the
+// union of 4 rows of boxes, or'ed with themselves shifted by one box along x
+static void dilateToNodes(const Array3D<bool> & boxes, Array3D<bool> & nodes)
+{
+	const int Xs = boxes.getSize(0), Ys = boxes.getSize(1), Zs = boxes.getSize(2);
+	nodes.init(Xs + 1, Ys + 1, Zs + 1);
+	const int boxWords = boxes.getRowWords(), nodeWords = nodes.getRowWords();
+#pragma omp parallel for
+	for (int z = 0; z < Zs + 1; z++) {
+		for (int y = 0; y < Ys + 1; y++) {
+			uint64_t * out = nodes.row(y, z);
+			for (int dz = -1; dz < 1; dz++) {
+				for (int dy = -1; dy < 1; dy++) {
+					if (y + dy < 0 || y + dy >= Ys || z + dz < 0 || z + dz >= Zs) continue;
+					const uint64_t * in = boxes.row(y + dy, z + dz);
+					for (int w = 0; w < nodeWords; w++) {
+						const uint64_t cur = (w < boxWords) ? in[w] : 0;
+						const uint64_t prev = (w > 0 && w - 1 < boxWords) ? in[w - 1] : 0;
+						out[w] |= cur | (cur << 1) | (prev >> 63);
+					}
+				}
+			}
+		}
+	}
+}
+void BoxGrid::initVoxels(const int res, const Array3D<bool>& m_voxArray) {
 
 	m_size[0] = m_size[1] = m_size[2] = res;
 	m_lowerLeft.setZero();
@@ -9,122 +78,117 @@ void BoxGrid::initVoxels(const int res, Array3D<int>& m_voxArray) {
 	const int & Xs = m_size[0];
 	const int & Ys = m_size[1];
 	const int & Zs = m_size[2];
-	m_boxArray.init(Xs, Ys, Zs);
 	m_nodeArray.init(Xs + 1, Ys + 1, Zs + 1);
 	m_frac = (m_upperRight - m_lowerLeft).cwiseQuotient(RowVector3(Xs, Ys, Zs));
-
-	m_boxArray.setAllTo(-1);
-	nnzBoxes = 0;
-	for (int x = 0; x<Xs; x++) {
-		for (int y = 0; y<Ys; y++) {
-			for (int z = 0; z<Zs; z++) {
-				if (m_voxArray(x,y,z) != -1) {
-					m_boxArray(x, y, z) = nnzBoxes++;
-				}
+	m_boxOccupancy = m_voxArray;
+	numberBoxes();
+}
+void BoxGrid::numberBoxes()
+{
+	nnzBoxes = numberOccupied(m_boxOccupancy, m_boxArray);
+}
+// bits 0..20 of v moved to every third bit
+static inline uint64_t spreadBits(uint64_t v)
+{
+	v &= 0x1fffff;
+	v = (v | v << 32) & 0x1f00000000ffffULL;
+	v = (v | v << 16) & 0x1f0000ff0000ffULL;
+	v = (v | v << 8) & 0x100f00f00f00f00fULL;
+	v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+	v = (v | v << 2) & 0x1249249249249249ULL;
+	return v;
+}
+// renumbers the n entries of ids (the ones != -1) in the Morton order of their x, y, z coordinates
+static void mortonRenumber(Array3D<int> & ids, int n)
+{
+	const int Xs = ids.getSize(0), Ys = ids.getSize(1), Zs = ids.getSize(2);
+	vector<pair<uint64_t, int> > codes(n);
+#pragma omp parallel for
+	for (int z = 0; z < Zs; z++)
+		for (int y = 0; y < Ys; y++)
+			for (int x = 0; x < Xs; x++) {
+				const int id = ids(x, y, z);
+				if (id != -1) codes[id] = make_pair(spreadBits(x) | spreadBits(y) << 1 | spreadBits(z) << 2, id);
 			}
-		}
+	sort(codes.begin(), codes.end());
+	vector<int> newId(n);
+#pragma omp parallel for
+	for (int i = 0; i < n; i++) newId[codes[i].second] = i;
+#pragma omp parallel for
+	for (int z = 0; z < Zs; z++)
+		for (int y = 0; y < Ys; y++)
+			for (int x = 0; x < Xs; x++) {
+				const int id = ids(x, y, z);
+				if (id != -1) ids(x, y, z) = newId[id];
+			}
+}
+// the 6 neighbours (-x, -y, -z, +x, +y, +z) of entry (x, y, z) of ids into row id of table, -1 where there are none
+static inline void fillNeighbors(const Array3D<int> & ids, int x, int y, int z, MatrixX6i & table, int id)
+{
+	int k = 0;
+	for (int dw = -1; dw <= 1; dw += 2) {
+		if (ids.validIndices(x + dw, y, z)) table(id, k) = ids(x + dw, y, z);
+		k++;
+		if (ids.validIndices(x, y + dw, z)) table(id, k) = ids(x, y + dw, z);
+		k++;
+		if (ids.validIndices(x, y, z + dw)) table(id, k) = ids(x, y, z + dw);
+		k++;
 	}
 }
+// The ids grow along z but the arrays are contiguous along x: the tables are filled by slabs of kTile x
+// values (one per thread), sweeping x innermost, so that the neighbour reads and the id writes both stay local
+static const int kTile = 16;
 //oct-tree
 void BoxGrid::initStructure() {
 	const int & Xs = m_size[0];
 	const int & Ys = m_size[1];
 	const int & Zs = m_size[2];
-	m_nodeArray.setAllTo(-1);
-	nnzNodes = 0;
-	for (int x = 0; x<Xs + 1; x++) {
-		for (int y = 0; y<Ys + 1; y++) {
-			for (int z = 0; z<Zs + 1; z++) {
-				bool occupiedNeighboringBox = false;
-				for (int dx = -1; dx<1; dx++) {
-					for (int dy = -1; dy<1; dy++) {
-						for (int dz = -1; dz<1; dz++) {
-							if (m_boxArray.validIndices(x + dx, y + dy, z + dz)) {
-								if (m_boxArray(x + dx, y + dy, z + dz) != -1) occupiedNeighboringBox = true;
-							}
-						}
-					}
-				}
-				if (occupiedNeighboringBox) m_nodeArray(x, y, z) = nnzNodes++;
-			}
-		}
+	{
+		Array3D<bool> nodeOccupancy;
+		dilateToNodes(m_boxOccupancy, nodeOccupancy);
+		nnzNodes = numberOccupied(nodeOccupancy, m_nodeArray);
 	}
-
-	m_nodes.assign(nnzNodes, RowVector3(0, 0, 0));
-	for (int x = 0; x<Xs + 1; x++) {
-		for (int y = 0; y<Ys + 1; y++) {
-			for (int z = 0; z<Zs + 1; z++) {
-				const int nIdx = m_nodeArray(x, y, z);
-				if (nIdx != -1) {
-					m_nodes[nIdx] = m_lowerLeft + m_frac.cwiseProduct(RowVector3(x, y, z));
-				}
-			}
-		}
+	if (m_mortonOrder) {
+		mortonRenumber(m_nodeArray, nnzNodes);
+		mortonRenumber(m_boxArray, nnzBoxes);
 	}
 
+	m_nodes.assign(nnzNodes, RowVector3(0, 0, 0));
 	m_nodeNodes.setConstant(nnzNodes, 6, -1);
-	for (int x = 0; x<Xs + 1; x++) {
-		for (int y = 0; y<Ys + 1; y++) {
-			for (int z = 0; z<Zs + 1; z++) {
-				if (m_nodeArray(x, y, z) == -1) continue;
-				int idNode = m_nodeArray(x, y, z);
-				int k = 0;
-				for (int dw = -1; dw <= 1; dw += 2) {
-					if (m_nodeArray.validIndices(x + dw, y, z)) {
-						m_nodeNodes(idNode, k) = m_nodeArray(x + dw, y, z);
-					}
-					k++;
-					if (m_nodeArray.validIndices(x, y + dw, z)) {
-						m_nodeNodes(idNode, k) = m_nodeArray(x, y + dw, z);
-					}
-					k++;
-					if (m_nodeArray.validIndices(x, y, z + dw)) {
-						m_nodeNodes(idNode, k) = m_nodeArray(x, y, z + dw);
-					}
-					k++;
+#pragma omp parallel for schedule(dynamic)
+	for (int x0 = 0; x0 < Xs + 1; x0 += kTile) {
+		const int x1 = min(x0 + kTile, Xs + 1);
+		for (int y = 0; y < Ys + 1; y++) {
+			for (int z = 0; z < Zs + 1; z++) {
+				for (int x = x0; x < x1; x++) {
+					const int idNode = m_nodeArray(x, y, z);
+					if (idNode == -1) continue;
+					m_nodes[idNode] = m_lowerLeft + m_frac.cwiseProduct(RowVector3(x, y, z));
+					fillNeighbors(m_nodeArray, x, y, z, m_nodeNodes, idNode);
 				}
 			}
 		}
 	}
 
 	m_boxNodes.setConstant(nnzBoxes, 8, -1);
-	for (int x = 0; x<Xs; x++) {
-		for (int y = 0; y<Ys; y++) {
-			for (int z = 0; z<Zs; z++) {
-				const int idBox = m_boxArray(x, y, z);
-				if (idBox == -1) continue;
-				int cnt = 0;
-				for (int dx = 0; dx<2; dx++) {
-					for (int dy = 0; dy<2; dy++) {
-						for (int dz = 0; dz<2; dz++) {
-							m_boxNodes(idBox, cnt++) = m_nodeArray(x + dx, y + dy, z + dz);
-						}
-					}
-				}
-			}
-		}
-	}
-
 	m_boxBoxes.setConstant(nnzBoxes, 6, -1);
-	for (int x = 0; x<Xs; x++) {
-		for (int y = 0; y<Ys; y++) {
-			for (int z = 0; z<Zs; z++) {
-				if (m_boxArray(x, y, z) == -1) continue;
-				int idBox = m_boxArray(x, y, z);
-				int k = 0;
-				for (int dw = -1; dw <= 1; dw += 2) {
-					if (m_boxArray.validIndices(x + dw, y, z)) {
-						m_boxBoxes(idBox, k) = m_boxArray(x + dw, y, z);
-					}
-					k++;
-					if (m_boxArray.validIndices(x, y + dw, z)) {
-						m_boxBoxes(idBox, k) = m_boxArray(x, y + dw, z);
-					}
-					k++;
-					if (m_boxArray.validIndices(x, y, z + dw)) {
-						m_boxBoxes(idBox, k) = m_boxArray(x, y, z + dw);
+#pragma omp parallel for schedule(dynamic)
+	for (int x0 = 0; x0 < Xs; x0 += kTile) {
+		const int x1 = min(x0 + kTile, Xs);
+		for (int y = 0; y < Ys; y++) {
+			for (int z = 0; z < Zs; z++) {
+				for (int x = x0; x < x1; x++) {
+					const int idBox = m_boxArray(x, y, z);
+					if (idBox == -1) continue;
+					int cnt = 0;
+					for (int dx = 0; dx<2; dx++) {
+						for (int dy = 0; dy<2; dy++) {
+							for (int dz = 0; dz<2; dz++) {
+								m_boxNodes(idBox, cnt++) = m_nodeArray(x + dx, y + dy, z + dz);
+							}
+						}
 					}
-					k++;
+					fillNeighbors(m_boxArray, x, y, z, m_boxBoxes, idBox);
 				}
 			}
 		}
@@ -134,37 +198,33 @@ void BoxGrid::freeAll()
 {
 	m_nodeArray.free();
 	m_boxArray.free();
+	m_boxOccupancy.free();
 	m_nodes.clear();
 }
+bool BoxGrid::gridCoords(const RowVector3 & P, RowVector3i & box, RowVector3 & t) const
+{
+	if (P.cwiseMin(m_lowerLeft) != m_lowerLeft || P.cwiseMax(m_upperRight) != m_upperRight) return false;
+	const RowVector3 floatIndices = (P - m_lowerLeft).cwiseQuotient(m_frac);
+	box = RowVector3i((int)floor(floatIndices[0]), (int)floor(floatIndices[1]), (int)floor(floatIndices[2]));
+	if (!m_boxArray.validIndices(box[0], box[1], box[2])) return false;
+	t = floatIndices - RowVector3(box[0], box[1], box[2]);
+	return true;
+}
 int BoxGrid::getBoxContainingPoint(const RowVector3 & P, RowVector3 & t) const
 {
-	if (P.cwiseMin(m_lowerLeft) != m_lowerLeft || P.cwiseMax(m_upperRight) != m_upperRight) {
+	RowVector3i box;
+	if (!gridCoords(P, box, t)) {
 		cout << "Error : point is outside the voxelgrid" << endl;
-		//P = P.cwiseMax(m_lowerLeft).cwiseMin(m_upperRight);
-		return -1;
-	}
-	RowVector3 floatIndices = (P - m_lowerLeft).cwiseQuotient(m_frac);
-	RowVector3i intIndices((int)floor(floatIndices[0]), (int)floor(floatIndices[1]), (int)floor(floatIndices[2]));
-	if (!m_boxArray.validIndices(intIndices[0], intIndices[1], intIndices[2])) {
-		cout << "Error : position in voxelgrid incorrect" << endl;
 		return -1;
 	}
-	t = floatIndices - RowVector3(intIndices[0], intIndices[1], intIndices[2]);
-	return m_boxArray(intIndices[0], intIndices[1], intIndices[2]);
+	return m_boxArray(box[0], box[1], box[2]);
 }
 
 bool BoxGrid::getBoxCoordsContainingPoint(const RowVector3 & P, RowVector3i & t) const
 {
-	if (P.cwiseMin(m_lowerLeft) != m_lowerLeft || P.cwiseMax(m_upperRight) != m_upperRight) {
+	RowVector3 local;
+	if (!gridCoords(P, t, local)) {
 		cout << "Error : point is outside the voxelgrid" << endl;
-		//P = P.cwiseMax(m_lowerLeft).cwiseMin(m_upperRight);
-		return false;
-	}
-	RowVector3 floatIndices = (P - m_lowerLeft).cwiseQuotient(m_frac);
-	t = RowVector3i((int)floor(floatIndices[0]), (int)floor(floatIndices[1]), (int)floor(floatIndices[2]));
-
-	if (!m_boxArray.validIndices(t[0], t[1], t[2])) {
-		cout << "Error : position in voxelgrid incorrect" << endl;
 		return false;
 	}
 	return true;
@@ -172,22 +232,78 @@ bool BoxGrid::getBoxCoordsContainingPoint(const RowVector3 & P, RowVector3i & t)
 
 int BoxGrid::getNodeClosestToPoint(const RowVector3 & P) const
 {
-	if (P.cwiseMin(m_lowerLeft) != m_lowerLeft || P.cwiseMax(m_upperRight) != m_upperRight) {
+	RowVector3i box;
+	RowVector3 t;
+	if (!gridCoords(P, box, t)) {
 		cout << "Error : point is outside the voxelgrid" << endl;
-		//P = P.cwiseMax(m_lowerLeft).cwiseMin(m_upperRight);
 		return -1;
 	}
-	RowVector3 floatIndices = (P - m_lowerLeft).cwiseQuotient(m_frac);
-	RowVector3i intIndices((int)floor(floatIndices[0]), (int)floor(floatIndices[1]), (int)floor(floatIndices[2]));
-	if (!m_boxArray.validIndices(intIndices[0], intIndices[1], intIndices[2])) {
-		cout << "Error : position in voxelgrid incorrect" << endl;
-		return -1;
+	return closestNode(box, t);
+}
+
+int BoxGrid::closestNode(const RowVector3i & box, const RowVector3 & t) const
+{
+	const int dx = (t[0] <= 0.5) ? 0 : 1;
+	const int dy = (t[1] <= 0.5) ? 0 : 1;
+	const int dz = (t[2] <= 0.5) ? 0 : 1;
+	return m_nodeArray(box[0] + dx, box[1] + dy, box[2] + dz);
+}
+
+// the rows of each thread are contiguous (static schedule), so concatenating the lists in thread order keeps them sorted
+static void gatherRows(vector<vector<int> > & perThread, vector<int> & rows)
+{
+	rows.clear();
+	for (size_t k = 0; k < perThread.size(); ++k) rows.insert(rows.end(), perThread[k].begin(), perThread[k].end());
+}
+
+void BoxGrid::getBoxesContainingPoints(const PointMatrixType & P, PointLocations & loc) const
+{
+	const int numPoints = P.rows();
+	loc.resize(numPoints);
+	vector<vector<int> > outside(omp_get_max_threads());
+#pragma omp parallel
+	{
+		vector<int> & rows = outside[omp_get_thread_num()];
+#pragma omp for schedule(static)
+		for (int v = 0; v < numPoints; ++v) {
+			RowVector3i box;
+			RowVector3 t;
+			const int idBox = gridCoords(P.row(v), box, t) ? m_boxArray(box[0], box[1], box[2]) : -1;
+			loc.boxes[v] = idBox;
+			if (idBox == -1) {
+				rows.push_back(v);
+				continue;
+			}
+			loc.t[0][v] = t[0];
+			loc.t[1][v] = t[1];
+			loc.t[2][v] = t[2];
+		}
 	}
-	RowVector3 t = floatIndices - RowVector3(intIndices[0], intIndices[1], intIndices[2]);
-	int dx = (t[0] <= 0.5) ? 0 : 1;
-	int dy = (t[1] <= 0.5) ? 0 : 1;
-	int dz = (t[2] <= 0.5) ? 0 : 1;
-	return m_nodeArray(intIndices[0] + dx, intIndices[1] + dy, intIndices[2] + dz);
+	gatherRows(outside, loc.outside);
+}
+
+void BoxGrid::getNodesClosestToPoints(const PointMatrixType & P, vector<int> & nodes, vector<int> & outside) const
+{
+	const int numPoints = P.rows();
+	nodes.assign(numPoints, -1);
+	vector<vector<int> > perThread(omp_get_max_threads());
+#pragma omp parallel
+	{
+		vector<int> & rows = perThread[omp_get_thread_num()];
+#pragma omp for schedule(static)
+		for (int v = 0; v < numPoints; ++v) {
+			RowVector3i box;
+			RowVector3 t;
+			if (gridCoords(P.row(v), box, t)) nodes[v] = closestNode(box, t);
+			if (nodes[v] == -1) rows.push_back(v);
+		}
+	}
+	gatherRows(perThread, outside);
+}
+
+float BoxGrid::getWeight(int idHandle, int idNode) const
+{
+	return (float)m_weights.get(idNode, idHandle);
 }
 
 const RowVector3 & BoxGrid::getNodePose(int idNode) const {
@@ -204,72 +320,497 @@ void BoxGrid::computeBoxPositions() {
 	}
 	m_boxPositions *= 0.125;
 }
-void BoxGrid::laplacianMEL(vector<SparseMatrixTriplet> &MEL) const
+void BoxGrid::laplacianMEL(vector<QPSparseMatrixTriplet> &MEL) const
 {
 	MEL.clear();
+	MEL.reserve(7 * getNumNodes());
 	vector<int> valences;
 	valences.assign(getNumNodes(), 0);
 	for (int v1 = 0; v1<getNumNodes(); ++v1) {
 		for (int k = 0; k < 6; ++k) {
 			int v2 = m_nodeNodes(v1, k);
 			if (v2 != -1) {
-				MEL.push_back(SparseMatrixTriplet(v1, v2, -1.0f));
+				MEL.push_back(QPSparseMatrixTriplet(v1, v2, -1.0f));
 				valences[v1]++;
 			}
 		}
 	}
 	for (int v = 0; v<getNumNodes(); v++) {
-		MEL.push_back(SparseMatrixTriplet(v, v, valences[v]));
+		MEL.push_back(QPSparseMatrixTriplet(v, v, valences[v]));
+	}
+}
+// sorts a few (index, value) entries by index (insertion sort, the columns are tiny)
+static void sortColumn(int n, int * idx, QPScalarType * val)
+{
+	for (int i = 1; i < n; i++) {
+		const int id = idx[i];
+		const QPScalarType v = val[i];
+		int j = i - 1;
+		for (; j >= 0 && idx[j] > id; j--) {
+			idx[j + 1] = idx[j];
+			val[j + 1] = val[j];
+		}
+		idx[j + 1] = id;
+		val[j + 1] = v;
+	}
+}
+GridBiharmonicOperator::GridBiharmonicOperator(const MatrixX6i & nodeNodes, QPScalarType scale)
+	: m_scale(scale), m_coarser(NULL)
+{
+	m_size = nodeNodes.rows();
+	m_valence.setZero(m_size);
+	for (int k = 0; k < 6; ++k) {
+		m_neighbors[k].resize(m_size);
+		for (int v = 0; v < m_size; ++v) {
+			const int n = nodeNodes(v, k);
+			m_neighbors[k][v] = (n != -1) ? n : v;
+			if (n != -1) m_valence[v] += 1;
+		}
+	}
+}
+void GridBiharmonicOperator::applyLaplacian(const QPScalarType * x, QPScalarType * y) const
+{
+	const int * n0 = &m_neighbors[0][0];
+	const int * n1 = &m_neighbors[1][0];
+	const int * n2 = &m_neighbors[2][0];
+	const int * n3 = &m_neighbors[3][0];
+	const int * n4 = &m_neighbors[4][0];
+	const int * n5 = &m_neighbors[5][0];
+#pragma omp parallel for
+	for (int v = 0; v < m_size; ++v) {
+		y[v] = 6 * x[v] - (x[n0[v]] + x[n1[v]] + x[n2[v]] + x[n3[v]] + x[n4[v]] + x[n5[v]]);
+	}
+}
+void GridBiharmonicOperator::apply(const QPVectorX &x, QPVectorX &y) const
+{
+	QPVectorX Lx(m_size);
+	y.resize(m_size);
+	applyLaplacian(x.data(), Lx.data());
+	applyLaplacian(Lx.data(), y.data());
+	if (m_scale != 1) y *= m_scale;
+}
+// (L^2)_vv = sum_k L_vk^2 = valence^2 + valence
+void GridBiharmonicOperator::diagonal(QPVectorX &d) const
+{
+	d = m_scale * (m_valence.cwiseProduct(m_valence) + m_valence);
+}
+void GridBiharmonicOperator::setCoarser(GridBiharmonicOperator * coarser, const QPSparseMatrix & P)
+{
+	delete m_coarser;
+	m_coarser = coarser;
+	m_P = P;
+}
+// coarse grid of 2x2x2 boxes: a coarse box is occupied if one of its fine boxes is, the nodes and their
+// 6-neighbourhood are numbered as in initStructure, and P interpolates the coarse nodes trilinearly at the
+// fine ones (every fine node lies on a face, edge or corner of the coarse box of one of its boxes)
+static void coarsenGrid(const Array3D<bool> & occupancy, const Array3D<int> & nodeArray, int numNodes,
+	Array3D<bool> & coarseOccupancy, Array3D<int> & coarseNodeArray, MatrixX6i & coarseNodeNodes, QPSparseMatrix & P)
+{
+	const int Xs = (occupancy.getSize(0) + 1) / 2, Ys = (occupancy.getSize(1) + 1) / 2, Zs = (occupancy.getSize(2) + 1) / 2;
+	coarseOccupancy.init(Xs, Ys, Zs);
+	for (int x = 0; x < occupancy.getSize(0); x++)
+		for (int y = 0; y < occupancy.getSize(1); y++)
+			for (int z = 0; z < occupancy.getSize(2); z++)
+				if (occupancy(x, y, z)) coarseOccupancy.set(x / 2, y / 2, z / 2, true);
+
+	coarseNodeArray.init(Xs + 1, Ys + 1, Zs + 1);
+	coarseNodeArray.setAllTo(-1);
+	int nnzNodes = 0;
+	for (int x = 0; x < Xs + 1; x++) {
+		for (int y = 0; y < Ys + 1; y++) {
+			for (int z = 0; z < Zs + 1; z++) {
+				bool occupiedNeighboringBox = false;
+				for (int d = 0; d < 8 && !occupiedNeighboringBox; d++) {
+					const int bx = x - 1 + d / 4, by = y - 1 + (d / 2) % 2, bz = z - 1 + d % 2;
+					occupiedNeighboringBox = coarseOccupancy.validIndices(bx, by, bz) && coarseOccupancy(bx, by, bz);
+				}
+				if (occupiedNeighboringBox) coarseNodeArray(x, y, z) = nnzNodes++;
+			}
+		}
+	}
+	coarseNodeNodes.setConstant(nnzNodes, 6, -1);
+	for (int x = 0; x < Xs + 1; x++) {
+		for (int y = 0; y < Ys + 1; y++) {
+			for (int z = 0; z < Zs + 1; z++) {
+				const int idNode = coarseNodeArray(x, y, z);
+				if (idNode == -1) continue;
+				int k = 0;
+				for (int dw = -1; dw <= 1; dw += 2) {
+					if (coarseNodeArray.validIndices(x + dw, y, z)) coarseNodeNodes(idNode, k) = coarseNodeArray(x + dw, y, z);
+					k++;
+					if (coarseNodeArray.validIndices(x, y + dw, z)) coarseNodeNodes(idNode, k) = coarseNodeArray(x, y + dw, z);
+					k++;
+					if (coarseNodeArray.validIndices(x, y, z + dw)) coarseNodeNodes(idNode, k) = coarseNodeArray(x, y, z + dw);
+					k++;
+				}
+			}
+		}
+	}
+
+	vector<QPSparseMatrixTriplet> P_MEL;
+	P_MEL.reserve(8 * numNodes);
+	for (int x = 0; x < nodeArray.getSize(0); x++) {
+		for (int y = 0; y < nodeArray.getSize(1); y++) {
+			for (int z = 0; z < nodeArray.getSize(2); z++) {
+				const int idNode = nodeArray(x, y, z);
+				if (idNode == -1) continue;
+				// odd coordinates lie halfway between two coarse nodes
+				for (int c = 0; c < 8; c++) {
+					const int dx = c / 4, dy = (c / 2) % 2, dz = c % 2;
+					if ((dx && x % 2 == 0) || (dy && y % 2 == 0) || (dz && z % 2 == 0)) continue;
+					const QPScalarType w = ((x % 2) ? 0.5 : 1.0) * ((y % 2) ? 0.5 : 1.0) * ((z % 2) ? 0.5 : 1.0);
+					const int idCoarse = coarseNodeArray(x / 2 + dx, y / 2 + dy, z / 2 + dz);
+					assert(idCoarse != -1);
+					P_MEL.push_back(QPSparseMatrixTriplet(idNode, idCoarse, w));
+				}
+			}
+		}
+	}
+	P.resize(numNodes, nnzNodes);
+	P.setFromTriplets(P_MEL.begin(), P_MEL.end());
+}
+QPoperator * BoxGrid::biharmonicOperator(int levels) const
+{
+	GridBiharmonicOperator * op = new GridBiharmonicOperator(m_nodeNodes);
+	// coarser grids down to a few hundred nodes. In node units L^2 is h^4 times the continuous operator,
+	// so its energy for a given function scales with h: the coarse operators are halved at every level,
+	// as the Galerkin product P'(L^2)P would be.
+	GridBiharmonicOperator * fine = op;
+	const Array3D<bool> * occupancy = &m_boxOccupancy;
+	const Array3D<int> * nodeArray = &m_nodeArray;
+	Array3D<bool> coarseOccupancy[2];
+	Array3D<int> coarseNodeArray[2];
+	QPScalarType scale = 1;
+	for (int l = 0; l < levels && fine->size() > 300; ++l) {
+		MatrixX6i coarseNodeNodes;
+		QPSparseMatrix P;
+		coarsenGrid(*occupancy, *nodeArray, fine->size(), coarseOccupancy[l % 2], coarseNodeArray[l % 2], coarseNodeNodes, P);
+		scale *= 0.5;
+		GridBiharmonicOperator * coarse = new GridBiharmonicOperator(coarseNodeNodes, scale);
+		fine->setCoarser(coarse, P);
+		fine = coarse;
+		occupancy = &coarseOccupancy[l % 2];
+		nodeArray = &coarseNodeArray[l % 2];
+	}
+	return op;
+}
+static PointMatrixType handlePoints(const vector<RowVector3> & handles)
+{
+	PointMatrixType P(handles.size(), 3);
+	for (size_t i = 0; i < handles.size(); ++i) P.row(i) = handles[i];
+	return P;
+}
+// The coarse grid covers the same space with boxes twice as large, so the handles keep their position
+// and P brings its node weights back to this grid. Its own solve cascades down the remaining levels.
+bool BoxGrid::coarseSolution(const vector<RowVector3> & handles, QPMatrixXX & W) const
+{
+	if (m_cascadeLevels <= 0 || m_size.minCoeff() < 8 || handles.empty()) return false;
+	BoxGrid coarse;
+	MatrixX6i coarseNodeNodes;
+	QPSparseMatrix P;
+	coarse.m_size = (m_size + Vector3i::Ones()) / 2;
+	coarse.m_lowerLeft = m_lowerLeft;
+	coarse.m_frac = 2 * m_frac;
+	coarse.m_upperRight = m_lowerLeft + coarse.m_frac.cwiseProduct(RowVector3(coarse.m_size[0], coarse.m_size[1], coarse.m_size[2]));
+	coarsenGrid(m_boxOccupancy, m_nodeArray, nnzNodes, coarse.m_boxOccupancy, coarse.m_nodeArray, coarseNodeNodes, P);
+	coarse.numberBoxes();
+	coarse.initStructure(); // numbers the nodes as coarsenGrid did
+	if (coarse.getNumNodes() != P.cols()) return false;
+
+	// two handles pinned at the same coarse node would make its QP infeasible
+	vector<int> nodes, outside;
+	coarse.getNodesClosestToPoints(handlePoints(handles), nodes, outside);
+	sort(nodes.begin(), nodes.end());
+	if (!outside.empty() || adjacent_find(nodes.begin(), nodes.end()) != nodes.end()) return false;
+
+	coarse.setSolver(m_solverName);
+	coarse.setSolverThreads(m_handleThreads, m_solverThreads);
+	coarse.setCascade(m_cascadeLevels - 1);
+	QPMatrixXX Wc;
+	if (!coarse.solveBBW(handles, Wc)) return false;
+	W = P * Wc;
+	return true;
+}
+// L is symmetric, so the compressed columns are directly its rows: each column j holds -1 for the
+// neighbours of node j and the valence on the diagonal, written in place after a prefix sum of the sizes
+void BoxGrid::laplacian(QPSparseMatrix & L) const
+{
+	const int N = getNumNodes();
+	L.resize(N, N);
+	vector<int> sizes(N + 1, 0);
+#pragma omp parallel for
+	for (int v1 = 0; v1 < N; ++v1) {
+		int n = 1;
+		for (int k = 0; k < 6; ++k) if (m_nodeNodes(v1, k) != -1) n++;
+		sizes[v1 + 1] = n;
+	}
+	for (int v = 0; v < N; v++) sizes[v + 1] += sizes[v];
+	L.resizeNonZeros(sizes[N]);
+	int * outer = L.outerIndexPtr();
+	int * inner = L.innerIndexPtr();
+	QPScalarType * values = L.valuePtr();
+	for (int v = 0; v <= N; v++) outer[v] = sizes[v];
+#pragma omp parallel for
+	for (int v1 = 0; v1 < N; ++v1) {
+		int * idx = inner + outer[v1];
+		QPScalarType * val = values + outer[v1];
+		int n = 0;
+		for (int k = 0; k < 6; ++k) {
+			const int v2 = m_nodeNodes(v1, k);
+			if (v2 != -1) {
+				idx[n] = v2;
+				val[n++] = -1.0;
+			}
+		}
+		idx[n] = v1;
+		val[n] = n; // valence
+		n++;
+		sortColumn(n, idx, val);
+	}
+}
+// column j of L*L is sum_k L(k,j) L(:,k): gathered from the (few) neighbours of the neighbours of j,
+// in two passes (sizes, then values) so that the result is written in place without triplets.
+// slot: per thread, a small open-addressing table (mask + 1 entries, all -1) from a row to its entry in the column
+static int bilaplacianColumn(const QPSparseMatrix & L, int j, int * idx, QPScalarType * val, int * slot, unsigned int mask)
+{
+	const int * outer = L.outerIndexPtr();
+	const int * inner = L.innerIndexPtr();
+	const QPScalarType * values = L.valuePtr();
+	int n = 0;
+	for (int p = outer[j]; p < outer[j + 1]; p++) {
+		const int k = inner[p];
+		for (int q = outer[k]; q < outer[k + 1]; q++) {
+			const int i = inner[q];
+			unsigned int h = ((unsigned int)i * 2654435761u) & mask;
+			while (slot[h] != -1 && idx[slot[h]] != i) h = (h + 1) & mask;
+			if (slot[h] == -1) {
+				slot[h] = n;
+				idx[n] = i;
+				val[n++] = 0;
+			}
+			val[slot[h]] += values[q] * values[p];
+		}
+	}
+	for (unsigned int h = 0; h <= mask; h++) slot[h] = -1;
+	sortColumn(n, idx, val);
+	return n;
+}
+void BoxGrid::bilaplacian(const QPSparseMatrix & L, QPSparseMatrix & L2)
+{
+	const int N = L.cols();
+	int maxK = 0; // largest column of L, its square bounds the size of a column of L*L
+	for (int j = 0; j < N; j++) maxK = max(maxK, L.outerIndexPtr()[j + 1] - L.outerIndexPtr()[j]);
+	const int maxColumn = maxK * maxK;
+	unsigned int tableSize = 1; // at most half full
+	while (tableSize < 2 * (unsigned int)maxColumn) tableSize *= 2;
+	L2.resize(N, N);
+	vector<int> sizes(N + 1, 0);
+#pragma omp parallel
+	{
+		vector<int> idx(maxColumn), slot(tableSize, -1);
+		vector<QPScalarType> val(maxColumn);
+#pragma omp for
+		for (int j = 0; j < N; j++) sizes[j + 1] = bilaplacianColumn(L, j, &idx[0], &val[0], &slot[0], tableSize - 1);
+#pragma omp single
+		{
+			for (int j = 0; j < N; j++) sizes[j + 1] += sizes[j];
+			L2.resizeNonZeros(sizes[N]);
+			for (int j = 0; j <= N; j++) L2.outerIndexPtr()[j] = sizes[j];
+		}
+#pragma omp for
+		for (int j = 0; j < N; j++) {
+			bilaplacianColumn(L, j, L2.innerIndexPtr() + sizes[j], L2.valuePtr() + sizes[j], &slot[0], tableSize - 1);
+		}
+	}
+}
+// one bounded biharmonic QP per handle; the QPs only differ by their right-hand side so they are independent
+// and can be scheduled side by side. Q and A are set up once, each thread then opens its own solver session
+// (e.g. a MOSEK task) and reuses it for all the handles it picks up.
+bool BoxGrid::solveHandles(const QPinterface & qp, const vector<int> & toSolve, const vector<char> & warm, QPMatrixXX & W,
+	vector<double> & solveTimes) const
+{
+	const int N = W.rows();
+	const int M = W.cols();
+	const int numQPs = toSolve.size();
+	int handleThreads = m_handleThreads;
+	if (handleThreads <= 0) handleThreads = max(1, omp_get_num_procs() / m_solverThreads);
+	handleThreads = max(1, min(handleThreads, numQPs));
+	bool failed = false;
+#pragma omp parallel num_threads(handleThreads)
+	{
+		QPsession * session = qp.createSession(QPinterface::PRINT_NOTHING, m_solverThreads);
+		QPVectorX b, x, x0;
+#pragma omp for schedule(dynamic, 1) reduction(||:failed)
+		for (int k = 0; k < numQPs; ++k) { // for each handle we compute the weight
+			const int j = toSolve[k];
+			b.setZero(M, 1);
+			b[j] = 1.0f;
+			x.setZero(N, 1);
+			if (warm[j]) x0 = W.col(j);
+			const double start = omp_get_wtime();
+			if (!session->solve(x, b, warm[j] ? &x0 : NULL)) failed = true; // call QP solver
+			solveTimes[j] = omp_get_wtime() - start;
+			W.col(j) = x;
+		}
+		delete session;
 	}
+	if (failed) cout << "Error : BBW solve failed or did not converge for at least one handle" << endl;
+	return !failed;
 }
 //LaplaceCBeltrami operator, when applied to a function, is the trace of the function's Hessian:
 //Laplacian energy minimization Dirichlet energy functional stationary:
 //biharmonic second order of harmonic, fourth-order partial differential equation
-void BoxGrid::computeBBW(map<string, RowVector3> B)
+void BoxGrid::biharmonic(QPSparseMatrix & L2) const
 {
-	int N = getNumNodes();
-	int M = B.size();
-	// each voxel node will have weights
-	m_weights.clear();
-	m_weights.resize(N);
 	// compute the Laplacian matrix
-	SparseMatrix L, L2;
-	vector<SparseMatrixTriplet> L_MEL;
-	laplacianMEL(L_MEL);//second-order
-	L.resize(N, N);
-	L.setFromTriplets(L_MEL.begin(), L_MEL.end());
-	L2 = L*L;//fourth-order
+	QPSparseMatrix L;
+	laplacian(L);//second-order
+	bilaplacian(L, L2);//fourth-order
+}
+// one QP per handle position, W gets the (not normalized) weights of every node, one column per handle
+bool BoxGrid::solveBBW(const vector<RowVector3> & handles, QPMatrixXX & W)
+{
+	const int N = getNumUnknowns();
+	const int M = handles.size();
 	// compute the constraint matrix (each row corresponds to one handle)
-	SparseMatrix A(M, N);
-	vector<SparseMatrixTriplet> A_MEL;
-	A_MEL.reserve(M);
-	int i = 0;
-	for (map<string, RowVector3>::iterator it = B.begin(); it != B.end(); it++)
-	{
-		A_MEL.push_back(SparseMatrixTriplet(i, getNodeClosestToPoint(it->second), 1.0));
-		i++;
+	vector<int> nodes, outside;
+	getNodesClosestToPoints(handlePoints(handles), nodes, outside);
+	W.setZero(N, M);
+	if (!outside.empty()) {
+		cout << "Error : handles outside the voxelgrid:";
+		for (size_t i = 0; i < outside.size(); ++i) cout << " " << outside[i];
+		cout << endl;
+		m_numSolvedHandles = 0;
+		m_handleSolveTimes.assign(M, 0);
+		prolongateWeights(W);
+		return false;
 	}
+	QPSparseMatrix A(M, N);
+	vector<QPSparseMatrixTriplet> A_MEL;
+	A_MEL.reserve(M);
+	for (int i = 0; i < M; ++i) A_MEL.push_back(QPSparseMatrixTriplet(i, nodes[i], 1.0));
 	A.setFromTriplets(A_MEL.begin(), A_MEL.end());
-	VectorX x;
-	VectorX b;
-	MOSEKinterface mi0;
-	MatrixXX zeros0(L2.rows(), 1); zeros0.setZero();
-	for (int j = 0; j < M; ++j) { // for each handle we compute the weight
-		b.setZero(M, 1);
-		b[j] = 1.0f;
-		x.setZero(N, 1);			// 1: bounded else just biharmonic
-		mi0.solveQP_BBW_type(x, L2, zeros0, A, b, 1, MOSEKinterface::PRINT_NOTHING); // call Mosek QP solver
-		for (int i = 0; i < N; i++) { // we push the j-th weight for each node
-			m_weights[i].pushWeight((ScalarType)x[i]);
+	vector<int> toSolve;
+	vector<char> warm(M, 0);
+	if (hasIncrementalState()) selectHandles(nodes, W, toSolve, warm);
+	else {
+		for (int j = 0; j < M; ++j) toSolve.push_back(j);
+		BBWProfile::Scope scope(m_profile, "cascade");
+		if (coarseSolution(handles, W)) warm.assign(M, 1);
+	}
+	m_numSolvedHandles = toSolve.size();
+	m_handleSolveTimes.assign(M, 0);
+	QPinterface * qp = toSolve.empty() ? NULL : createQPinterface(m_solverName);
+	bool solved = toSolve.empty();
+	if (qp == NULL) {
+		if (!toSolve.empty()) cout << "Error : unknown QP solver " << m_solverName << endl;
+	}
+	else {
+		// matrix-free solvers get the stencil operator, the others the assembled matrix
+		QPoperator * L2op = qp->isMatrixFree() ? biharmonicOperator(qp->hierarchyLevels()) : NULL;
+		QPSparseMatrix L2;
+		bool ready;
+		if (L2op == NULL) {
+			BBWProfile::Scope scope(m_profile, "assembly");
+			if (!m_incremental) biharmonic(L2);
+			else if (!m_hasL2) { biharmonic(m_L2); m_hasL2 = true; }
+		}
+		{
+			BBWProfile::Scope scope(m_profile, "qpSetup");
+			if (L2op != NULL) ready = qp->setupOperator(*L2op, A, 1);
+			else ready = qp->setup(m_incremental ? m_L2 : L2, A, 1); // 1: bounded else just biharmonic
+		}
+		if (ready) {
+			BBWProfile::Scope scope(m_profile, "qpSolves");
+			solved = solveHandles(*qp, toSolve, warm, W, m_handleSolveTimes);
+		}
+		else cout << "Error : QP solver setup failed" << endl;
+		if (m_profile != NULL) m_profile->setHandleTimes(m_handleSolveTimes);
+		delete qp;
+		delete L2op;
+	}
+	// a failed solve is not kept for the next incremental one
+	if (m_incremental && solved) {
+		m_prevNodes = nodes;
+		m_prevSolution = W;
+		m_prevSolver = m_solverName;
+	}
+	else if (m_incremental) m_prevSolution.resize(0, 0);
+	prolongateWeights(W);
+	return solved;
+}
+// A handle pinned at the same node as before keeps its previous solution, unless its weights overlap a change:
+// a new pin where it weighed more than m_supportEps, or a released pin whose weights shared nodes with its own.
+// The handles it has to solve again start from their previous solution, the new handles from scratch.
+void BoxGrid::selectHandles(const vector<int> & nodes, QPMatrixXX & W, vector<int> & toSolve, vector<char> & warm) const
+{
+	const int N = W.rows();
+	const int M = nodes.size();
+	const ScalarType eps = m_supportEps;
+	map<int, int> previous; // pinned node -> previous handle
+	for (unsigned int p = 0; p < m_prevNodes.size(); ++p) previous[m_prevNodes[p]] = p;
+	set<int> current(nodes.begin(), nodes.end());
+	vector<int> addedNodes, removedHandles;
+	for (int i = 0; i < M; ++i) if (previous.find(nodes[i]) == previous.end()) addedNodes.push_back(nodes[i]);
+	for (unsigned int p = 0; p < m_prevNodes.size(); ++p) if (current.find(m_prevNodes[p]) == current.end()) removedHandles.push_back(p);
+
+	for (int i = 0; i < M; ++i) {
+		map<int, int>::const_iterator it = previous.find(nodes[i]);
+		if (it == previous.end()) {
+			toSolve.push_back(i);
+			continue;
+		}
+		const int p = it->second;
+		W.col(i) = m_prevSolution.col(p);
+		bool affected = false;
+		for (unsigned int k = 0; k < addedNodes.size() && !affected; ++k) affected = (m_prevSolution(addedNodes[k], p) > eps);
+		for (unsigned int k = 0; k < removedHandles.size() && !affected; ++k) {
+			const int r = removedHandles[k];
+			for (int v = 0; v < N && !affected; ++v) affected = (m_prevSolution(v, p) > eps && m_prevSolution(v, r) > eps);
+		}
+		if (affected) {
+			toSolve.push_back(i);
+			warm[i] = 1;
 		}
 	}
-	// for each node we now have all the weight so we can normalize them
+}
+void BoxGrid::clearIncremental()
+{
+	m_L2.resize(0, 0);
+	m_L2.data().squeeze();
+	m_hasL2 = false;
+	m_prevNodes.clear();
+	m_prevSolution.resize(0, 0);
+	m_prevSolver.clear();
+}
+// normalized weights of every node, the columns of W (one per solved handle) come first in each row of numHandles
+void BoxGrid::storeWeights(const QPMatrixXX & W, int numHandles)
+{
+	const int N = getNumNodes();
+	const int M = W.cols();
+	m_weights.setZero(N, numHandles);
+#pragma omp parallel for
 	for (int i = 0; i < N; i++) {
-		m_weights[i].normalizeWeights();
+		QPScalarType sum = 0;
+		for (int j = 0; j < M; ++j) sum += W(i, j);
+		if (sum > 0) for (int j = 0; j < M; ++j) m_weights.set(i, j, W(i, j) / sum);
+	}
+}
+bool BoxGrid::computeBBW(map<string, RowVector3> B)
+{
+	vector<RowVector3> handles;
+	for (map<string, RowVector3>::iterator it = B.begin(); it != B.end(); it++)
+	{
+		handles.push_back(it->second);
 	}
+	// each voxel node will have weights
+	QPMatrixXX W;
+	const bool solved = solveBBW(handles, W);
+	storeWeights(W, handles.size());
+	return solved;
 }
 //this is implemented by Zhiping 11/12/2014
-void BoxGrid::computeBoneBBW(map<string, RowVector3> B, map<string, string> boneWise)
+bool BoxGrid::computeBoneBBW(map<string, RowVector3> B, map<string, string> boneWise)
 {
 	vector<int> bones;
 	vector<RowVector3> boneLocs;
@@ -290,62 +831,23 @@ void BoxGrid::computeBoneBBW(map<string, RowVector3> B, map<string, string> bone
 	int N = getNumNodes();
 	int M = bones.size();
 	// each voxel node will have weights
-	m_weights.clear();
-	m_weights.resize(N);
-	// compute the Laplacian matrix
-	SparseMatrix L, L2;
-	vector<SparseMatrixTriplet> L_MEL;
-	laplacianMEL(L_MEL);//second-order
-	L.resize(N, N);
-	L.setFromTriplets(L_MEL.begin(), L_MEL.end());
-	L2 = L*L;//fourth-order
-	// compute the constraint matrix (each row corresponds to one handle)
-	SparseMatrix A(M, N);
-	vector<SparseMatrixTriplet> A_MEL;
-	A_MEL.reserve(M);
-	for (int i = 0; i < M; ++i) {
-		RowVector3 boneLoc = boneLocs[i];
-		int idNode = getNodeClosestToPoint(boneLoc);
-		A_MEL.push_back(SparseMatrixTriplet(i, idNode, 1.0));
-	}
-	A.setFromTriplets(A_MEL.begin(), A_MEL.end());
-	VectorX x;
-	VectorX b;
-	MOSEKinterface mi0;
-	MatrixXX zeros0(L2.rows(), 1); zeros0.setZero();
-	for (int j = 0; j < M; ++j) { // for each handle we compute the weight
-		b.setZero(M, 1);
-		b[j] = 1.0f;
-		x.setZero(N, 1);			// 1: bounded else just biharmonic
-		mi0.solveQP_BBW_type(x, L2, zeros0, A, b, 1, MOSEKinterface::PRINT_NOTHING); // call Mosek QP solver
-		for (int i = 0; i < N; i++) { // we push the j-th weight for each node
-			m_weights[i].pushWeight((ScalarType)x[i]);
-		}
-	}
-	// for each node we now have all the weight so we can normalize them
-	for (int i = 0; i < N; i++) {
-		m_weights[i].normalizeWeights();
-	}
-	vector<Weights> tmp_weights = m_weights;
-	tmp_weights.clear(); tmp_weights.resize(N);
-	for (int j = 0; j<B.size(); j++)
-	{
-		for (int i = 0; i < N; i++)
-		{
-			tmp_weights[i].pushWeight(0.0);
-		}
-	}
-	for (int j = 0; j<M; j++)
+	QPMatrixXX W;
+	const bool solved = solveBBW(boneLocs, W);
+	storeWeights(W, B.size());
+	// move the weight of each bone to the index of its parent joint, row by row
+#pragma omp parallel
 	{
+		vector<WeightMatrix::StorageType> boneWeights(M);
+#pragma omp for
 		for (int i = 0; i < N; i++)
 		{
-			tmp_weights[i].setCoord(bones[j], m_weights[i].getCoord(j));
+			WeightMatrix::StorageType * row = m_weights.row(i);
+			for (int j = 0; j < M; j++) boneWeights[j] = row[j];
+			for (int j = 0; j < m_weights.cols(); j++) row[j] = WeightMatrix::encode(0);
+			for (int j = 0; j < M; j++) row[bones[j]] = boneWeights[j];
 		}
 	}
-	m_weights = tmp_weights; tmp_weights.clear();
-	for (int i = 0; i < N; i++) {
-		m_weights[i].setSumCoords();
-	}
+	return solved;
 }
 void BoxGrid::getInterpolatedBBW(const RowVector3 & P, Weights & deformInfo, const int nbWeights) const {
 	RowVector3 t;
@@ -354,17 +856,109 @@ void BoxGrid::getInterpolatedBBW(const RowVector3 & P, Weights & deformInfo, con
 		cout << "Error cannot create BBW for this mesh vertex" << endl;
 		return;
 	}
-	for (int j = 0; j < nbWeights; ++j) {
-		float wj = 0.0f;
+	// accumulate the 8 corner rows, each one read contiguously
+	ScalarType stackWeights[64];
+	vector<ScalarType> heapWeights;
+	ScalarType * w = stackWeights;
+	if (nbWeights > 64) {
+		heapWeights.resize(nbWeights);
+		w = &heapWeights[0];
+	}
+	for (int j = 0; j < nbWeights; ++j) w[j] = 0;
+	for (int i = 0; i < 8; ++i) {
+		const int idNode = m_boxNodes(idBox, i);
+		ScalarType alpha = 1.0;
+		alpha *= (((i / 4) % 2 == 0) ? (1.0 - t[0]) : t[0]);
+		alpha *= (((i / 2) % 2 == 0) ? (1.0 - t[1]) : t[1]);
+		alpha *= ((i % 2 == 0) ? (1.0 - t[2]) : t[2]);
+		const WeightMatrix::StorageType * row = m_weights.row(idNode);
+		for (int j = 0; j < nbWeights; ++j) w[j] += alpha * WeightMatrix::decode(row[j]);
+	}
+	for (int j = 0; j < nbWeights; ++j) deformInfo.pushWeight(w[j]);
+	deformInfo.normalizeWeights();
+}
+int BoxGrid::getInterpolatedBBW(const PointMatrixType & P, RowMatrixXX & weights, const int nbWeights) const {
+	const int numPoints = P.rows();
+	weights.setZero(numPoints, nbWeights);
+	PointLocations loc;
+	getBoxesContainingPoints(P, loc);
+#pragma omp parallel for schedule(static, 256)
+	for (int v = 0; v < numPoints; ++v) {
+		const int idBox = loc.boxes[v];
+		if (idBox == -1) continue;
+		const ScalarType t[3] = { loc.t[0][v], loc.t[1][v], loc.t[2][v] };
+		// corner rows and trilinear coefficients, once per point
+		const WeightMatrix::StorageType * rows[8];
+		ScalarType alpha[8];
+		for (int i = 0; i < 8; ++i) {
+			rows[i] = m_weights.row(m_boxNodes(idBox, i));
+			alpha[i] = (((i / 4) % 2 == 0) ? (1.0 - t[0]) : t[0])
+				* (((i / 2) % 2 == 0) ? (1.0 - t[1]) : t[1])
+				* ((i % 2 == 0) ? (1.0 - t[2]) : t[2]);
+		}
+		// contiguous loops over the handles, left to the compiler to vectorize
+		ScalarType * w = weights.data() + (size_t)v * nbWeights;
 		for (int i = 0; i < 8; ++i) {
-			const int idNode = m_boxNodes(idBox, i);
-			float alpha = 1.0f;
-			alpha *= (((i / 4) % 2 == 0) ? (1.0f - t[0]) : t[0]);
-			alpha *= (((i / 2) % 2 == 0) ? (1.0f - t[1]) : t[1]);
-			alpha *= ((i % 2 == 0) ? (1.0f - t[2]) : t[2]);
-			wj += alpha * m_weights[idNode].getCoord(j);
+			const WeightMatrix::StorageType * row = rows[i];
+			const ScalarType a = alpha[i];
+			for (int j = 0; j < nbWeights; ++j) w[j] += a * WeightMatrix::decode(row[j]);
+		}
+		ScalarType sum = 0;
+		for (int j = 0; j < nbWeights; ++j) sum += w[j];
+		if (sum > 0) {
+			const ScalarType invSum = 1.0 / sum;
+			for (int j = 0; j < nbWeights; ++j) w[j] *= invSum;
 		}
-		deformInfo.pushWeight(wj);
 	}
-	deformInfo.normalizeWeights();
-}
\ No newline at end of file
+	const int outside = loc.outside.size();
+	if (outside > 0) cout << "Error cannot create BBW for " << outside << " mesh vertices (first: " << loc.outside[0] << ")" << endl;
+	return outside;
+}
+static uint64_t align64(uint64_t offset) { return (offset + 63) & ~(uint64_t)63; }
+bool BoxGrid::exportBBW(const string & filename, uint64_t key, const RowMatrixXX & vertexWeights) const
+{
+	BBWCacheHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, "BBWC", 4);
+	h.version = BBW_CACHE_VERSION;
+	h.key = key;
+	h.scalarSize = sizeof(ScalarType);
+	h.nodeWeightSize = sizeof(WeightMatrix::StorageType);
+	for (int k = 0; k < 3; ++k) {
+		h.gridSize[k] = m_size[k];
+		h.lowerLeft[k] = m_lowerLeft[k];
+		h.upperRight[k] = m_upperRight[k];
+	}
+	h.numNodes = m_weights.rows();
+	h.numHandles = m_weights.cols();
+	h.numVertices = vertexWeights.rows();
+	h.numBones = vertexWeights.cols();
+	const uint64_t nodeBytes = (uint64_t)h.numNodes * h.numHandles * h.nodeWeightSize;
+	const uint64_t vertexBytes = (uint64_t)h.numVertices * h.numBones * h.scalarSize;
+	h.nodeWeightsOffset = align64(sizeof(h));
+	h.vertexWeightsOffset = align64(h.nodeWeightsOffset + nodeBytes);
+	h.fileSize = h.vertexWeightsOffset + vertexBytes;
+
+	// written aside then renamed, so that a reader never maps a partial file
+	const string tmpName = filename + ".tmp";
+	FILE * f = fopen(tmpName.c_str(), "wb");
+	if (f == NULL) {
+		cout << "Error : cannot write the BBW cache " << filename << endl;
+		return false;
+	}
+	const char padding[64] = { 0 };
+	fwrite(&h, sizeof(h), 1, f);
+	fwrite(padding, 1, h.nodeWeightsOffset - sizeof(h), f);
+	if (nodeBytes > 0) fwrite(m_weights.row(0), 1, nodeBytes, f);
+	fwrite(padding, 1, h.vertexWeightsOffset - h.nodeWeightsOffset - nodeBytes, f);
+	if (vertexBytes > 0) fwrite(vertexWeights.data(), 1, vertexBytes, f);
+	bool ok = (ferror(f) == 0);
+	ok = (fclose(f) == 0) && ok;
+	// the previous cache stays in place unless the new one is complete
+	if (!ok || !replaceFile(tmpName, filename)) {
+		cout << "Error : cannot write the BBW cache " << filename << endl;
+		remove(tmpName.c_str());
+		return false;
+	}
+	return true;
+}
@@ -5,32 +5,94 @@
 #include "Array3D.h"
 #include "Weights.h"
 #include "EIGEN_inc.h"
+#include "qp_solver.h"
+#include "bbw_cache.h"
+#include "bbw_profile.h"
+
+// L^2 applied on the fly from the 6-neighbour tables, without storing the ~25 nonzeros per node of L^2.
+// Missing neighbours point to the node itself, so Lx = 6x - sum of the 6 neighbours holds for every node
+// and each neighbour direction is a contiguous, branch-free gather.
+class GridBiharmonicOperator : public QPoperator
+{
+public:
+	// scale * L^2
+	GridBiharmonicOperator(const MatrixX6i & nodeNodes, QPScalarType scale = 1);
+	virtual ~GridBiharmonicOperator() { delete m_coarser; }
+
+	virtual int size() const { return m_size; }
+	virtual void apply(const QPVectorX &x, QPVectorX &y) const;
+	virtual void diagonal(QPVectorX &d) const;
+
+	// takes coarser over, P (fine x coarse nodes) interpolates it to this grid
+	void setCoarser(GridBiharmonicOperator * coarser, const QPSparseMatrix & P);
+	virtual const QPoperator * coarser() const { return m_coarser; }
+	virtual void prolongate(const QPVectorX &xc, QPVectorX &x) const { x = m_P * xc; }
+	virtual void restrictTo(const QPVectorX &x, QPVectorX &xc) const { xc = m_P.transpose() * x; }
+
+private:
+	void applyLaplacian(const QPScalarType * x, QPScalarType * y) const;
+
+	int m_size;
+	vector<int> m_neighbors[6]; // one contiguous array per direction
+	QPVectorX m_valence;
+	QPScalarType m_scale;
+	GridBiharmonicOperator * m_coarser;
+	QPSparseMatrix m_P;
+};
+
+// Batched point location: the box of each point (-1 if none) and the point's coordinates in it (undefined
+// where the box is -1) as separate arrays, with the rows of the points that were not located, in increasing order
+struct PointLocations
+{
+	vector<int> boxes;
+	vector<ScalarType> t[3];
+	vector<int> outside;
+	void resize(int n) {
+		boxes.resize(n);
+		for (int k = 0; k < 3; k++) t[k].resize(n);
+	}
+};
 
 // Basic data structures for a 3D grid of regular boxes (not necessarily equilateral -- though some methods silently assume square boxes)
 // Some boxes can be empty, so we distinguish all elements (i.e. full 3D array) and non-empty ones (carving a subset of the 3D array)
 class BoxGrid {
 
 public:
-	BoxGrid(){}
-	~BoxGrid() {
+	BoxGrid() : m_handleThreads(1), m_solverThreads(4), m_solverName(defaultQPinterface()),
+		m_incremental(false), m_supportEps(1e-3), m_hasL2(false), m_numSolvedHandles(0), m_profile(NULL), m_cascadeLevels(0),
+		m_mortonOrder(false) {}
+	virtual ~BoxGrid() {
 		freeAll();
 	}
 
-	void initVoxels(const int res, Array3D<int>& m_voxArray);
-	void initStructure();
+	void initVoxels(const int res, const Array3D<bool>& m_voxArray);
+	virtual void initStructure();
 
 	int getNumNodes() const { return nnzNodes; }
+	// the QP variables are the first getNumUnknowns() nodes
+	virtual int getNumUnknowns() const { return nnzNodes; }
 	int getNumBoxes() const { return nnzBoxes; }
 
 	void getInterpolatedBBW(const RowVector3 & P, Weights & deformInfo, const int nbWeights) const;
-	void computeBBW(map<string, RowVector3> B);
-	void computeBoneBBW(map<string, RowVector3> B, map<string, string> boneWise);
-	void laplacianMEL(vector<SparseMatrixTriplet> &MEL) const;
+	// all the points at once (in parallel): one row of nbWeights normalized weights per point, rows of points
+	// outside the grid are left to zero. Returns the number of such points.
+	int getInterpolatedBBW(const PointMatrixType & P, RowMatrixXX & weights, const int nbWeights) const;
+	// false if a QP could not be set up or solved (the node weights are then not usable)
+	bool computeBBW(map<string, RowVector3> B);
+	bool computeBoneBBW(map<string, RowVector3> B, map<string, string> boneWise);
+	void laplacianMEL(vector<QPSparseMatrixTriplet> &MEL) const;
+	// graph Laplacian over the 6-neighbourhood, assembled in place from m_nodeNodes
+	void laplacian(QPSparseMatrix & L) const;
+	// L*L for a symmetric stencil matrix, column by column (at most 25 entries per column on the grid)
+	static void bilaplacian(const QPSparseMatrix & L, QPSparseMatrix & L2);
 	float getWeight(int idHandle, int idNode) const;
 
-	int getBoxContainingPoint(const RowVector3 & P, RowVector3 & t) const;
+	virtual int getBoxContainingPoint(const RowVector3 & P, RowVector3 & t) const;
 	bool getBoxCoordsContainingPoint(const RowVector3 & P, RowVector3i & t) const;
-	int getNodeClosestToPoint(const RowVector3 & P) const;
+	virtual int getNodeClosestToPoint(const RowVector3 & P) const;
+	// same lookups for all the rows of P, in parallel: the failures are listed instead of printed
+	virtual void getBoxesContainingPoints(const PointMatrixType & P, PointLocations & loc) const;
+	virtual void getNodesClosestToPoints(const PointMatrixType & P, vector<int> & nodes, vector<int> & outside) const;
 
 	void computeBoxPositions();
 	RowMatrixX3::ConstRowXpr getBoxPosition(int idBox) const { return m_boxPositions.row(idBox); }
@@ -41,7 +103,39 @@ public:
 	int getNodeNodes(int idNode, int idNeighbor) const { return m_nodeNodes(idNode, idNeighbor); }
 	int getBoxNodes(int idBox, int idNeighbor) const { return m_boxNodes(idBox, idNeighbor); }
 
-	void exportBBW(string filename);
+	// writes the grid metadata, the node weights and the weights interpolated at the mesh vertices in the
+	// binary cache format of bbw_cache.h, tagged with key
+	bool exportBBW(const string & filename, uint64_t key, const RowMatrixXX & vertexWeights) const;
+
+	// handleThreads QPs are solved side by side, each using solverThreads threads inside the solver (handleThreads <= 0: use all cores)
+	void setSolverThreads(int handleThreads, int solverThreads) { m_handleThreads = handleThreads; m_solverThreads = max(1, solverThreads); }
+	// QP backend, see createQPinterface
+	void setSolver(const string & name) { m_solverName = name; }
+	const string & getSolver() const { return m_solverName; }
+
+	// incremental mode: the biharmonic matrix and the solutions of the last solve are kept, so that solving again
+	// with a few handles moved, added or removed only re-solves (warm started) the new handles and the ones whose
+	// weights overlap a changed handle (above supportEps at the same nodes); the others keep their solution, so the
+	// weights are close to a full solve but not equal to it (5e-4 apart after adding a handle to a test rig)
+	void setIncremental(bool incremental, ScalarType supportEps = 1e-3) {
+		m_incremental = incremental;
+		m_supportEps = supportEps;
+		if (!incremental) clearIncremental();
+	}
+	void clearIncremental();
+	// the next solve can reuse the solutions of the last one (same solver, kept since): else it solves every handle
+	bool hasIncrementalState() const { return m_incremental && m_prevSolver == m_solverName && m_prevSolution.rows() == getNumUnknowns(); }
+	int getNumSolvedHandles() const { return m_numSolvedHandles; } // QPs solved by the last solve
+	// seconds spent in the QP of each handle by the last solve (0 for the handles it kept)
+	const vector<double> & getHandleSolveTimes() const { return m_handleSolveTimes; }
+	// stages of the solves are timed into profile (NULL: not profiled)
+	void setProfile(BBWProfile * profile) { m_profile = profile; }
+	// coarse-to-fine mode: the handles are first solved on up to levels grids of 2x2x2 boxes, each solution
+	// interpolated to the next finer grid as the starting point (and active set guess) of its solve
+	void setCascade(int levels) { m_cascadeLevels = max(0, levels); }
+	// nodes and boxes numbered along the Morton curve of their grid coordinates instead of x, y, z scan order,
+	// so that the 6 neighbours of a node are mostly close in memory (uniform grid, set before initStructure)
+	void setMortonOrder(bool morton) { m_mortonOrder = morton; }
 
 protected:
 	Vector3i m_size; // number of boxes in x,y,z dimensions
@@ -49,14 +143,52 @@ protected:
 	RowVector3 m_frac;
 	Array3D<int> m_nodeArray; // nodes 
 	Array3D<int> m_boxArray; // boxes
+	Array3D<bool> m_boxOccupancy; // occupied boxes (bit-packed)
 	int nnzBoxes, nnzNodes, nnzEdges[3];
 	void freeAll();
+	// numbers the occupied boxes of m_boxOccupancy into m_boxArray
+	void numberBoxes();
+	// voxel of P and its coordinates in [0, 1]^3 in the voxel, false outside the grid
+	bool gridCoords(const RowVector3 & P, RowVector3i & box, RowVector3 & t) const;
+	int closestNode(const RowVector3i & box, const RowVector3 & t) const;
+	// solves the handles listed in toSolve, the columns of W flagged in warm hold their starting point.
+	// The time of each solve goes to the handle's entry of solveTimes. False if a solve failed or did not converge.
+	bool solveHandles(const QPinterface & qp, const vector<int> & toSolve, const vector<char> & warm, QPMatrixXX & W,
+		vector<double> & solveTimes) const;
+	// false on a handle outside the grid, an unknown solver, a failed setup or a failed solve
+	bool solveBBW(const vector<RowVector3> & handles, QPMatrixXX & W);
+	// incremental mode: reuses the previous solutions of the handles still pinned at the same node
+	void selectHandles(const vector<int> & nodes, QPMatrixXX & W, vector<int> & toSolve, vector<char> & warm) const;
+	// QP matrix over the unknowns (the first rows of the nodes) and expansion of the solution to all the nodes
+	virtual void biharmonic(QPSparseMatrix & L2) const;
+	// same matrix as an operator for the matrix-free solvers, NULL if it has to be assembled (caller deletes),
+	// with up to levels coarser grids for the multigrid solvers
+	virtual QPoperator * biharmonicOperator(int levels) const;
+	virtual void prolongateWeights(QPMatrixXX & /*W*/) const {}
+	// coarse-to-fine mode: W gets the solution of the next coarser grid interpolated at the nodes,
+	// false if there is none (cascade off, grid too small or handles merged at a coarse node)
+	virtual bool coarseSolution(const vector<RowVector3> & handles, QPMatrixXX & W) const;
 	vector<RowVector3> m_nodes;
 	RowMatrixX3 m_boxPositions; // positions of boxes (isobarycenter)
 	MatrixX8i m_boxNodes; // numBoxes x 8 int matrix of node indices (incident to a given box)
 	MatrixX6i m_nodeNodes; // numNodes x 6 int matrix of node indices (incident to a given node)
 	MatrixX6i m_boxBoxes;
-	vector<Weights> m_weights;
+	WeightMatrix m_weights; // numNodes x numHandles
+	void storeWeights(const QPMatrixXX & W, int numHandles);
+	int m_handleThreads, m_solverThreads;
+	string m_solverName;
+	bool m_incremental;
+	ScalarType m_supportEps;
+	QPSparseMatrix m_L2; // kept in incremental mode
+	bool m_hasL2;
+	vector<int> m_prevNodes; // node pinned by each handle of the last solve
+	QPMatrixXX m_prevSolution; // and its (not normalized) solutions
+	string m_prevSolver;
+	int m_numSolvedHandles;
+	vector<double> m_handleSolveTimes;
+	BBWProfile * m_profile;
+	int m_cascadeLevels;
+	bool m_mortonOrder;
 };
 
 #endif
@@ -3,14 +3,24 @@
 
 //#define EIGEN_USE_MKL_ALL
 
+// Eigen runs scalar unless BBW_VECTORIZE is defined (CMake option BBW_VECTORIZE, with BBW_AVX2 for the
+// instruction set). The fixed-size types kept in members and std containers (RowVector3, Vector3i) are not
+// multiples of 16 bytes, so they need no alignment. A member of a fixed-size vectorizable type (Vector4,
+// Matrix44, RowMatrix84, ...) would need EIGEN_MAKE_ALIGNED_OPERATOR_NEW in its class and
+// Eigen::aligned_allocator in std containers.
+#ifndef BBW_VECTORIZE
 #define EIGEN_DONT_VECTORIZE
 #define EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT
+#endif
 
 #include <Eigen/Core>
 #include <Eigen/Sparse>
 
 
+// BBW_SINGLE_PRECISION: grid, node weights and interpolation in float, the QP solves stay in double
+#ifndef BBW_SINGLE_PRECISION
 #define USE_DOUBLE
+#endif
 
 typedef int IndexType;
 
@@ -69,6 +79,14 @@ typedef Eigen::Matrix<ScalarType, 8, 3, Eigen::RowMajor> RowMatrix83;
 typedef Eigen::Matrix<ScalarType, 8, 4, Eigen::RowMajor> RowMatrix84;
 typedef Eigen::Matrix<ScalarType, Eigen::Dynamic, 4, Eigen::RowMajor> RowMatrixX4;
 typedef Eigen::Matrix<ScalarType, Eigen::Dynamic, 1> RowMatrixX1;
+typedef Eigen::Matrix<ScalarType, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMatrixXX;
+
+// QP matrices and vectors (biharmonic operator, constraints, solutions)
+typedef double QPScalarType;
+typedef Eigen::Matrix<QPScalarType, Eigen::Dynamic, 1> QPVectorX;
+typedef Eigen::Matrix<QPScalarType, Eigen::Dynamic, Eigen::Dynamic> QPMatrixXX;
+typedef Eigen::SparseMatrix<QPScalarType> QPSparseMatrix;
+typedef Eigen::Triplet<QPScalarType, IndexType> QPSparseMatrixTriplet;
 
 #endif
 
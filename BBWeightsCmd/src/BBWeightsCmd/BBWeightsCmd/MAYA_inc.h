@@ -10,6 +10,8 @@
 /* Maya function set headers */
 #include <maya/MFnMesh.h>
 #include <maya/MFnSkinCluster.h>
+#include <maya/MFnSingleIndexedComponent.h>
+#include <maya/MDoubleArray.h>
 #include <maya/MFnDagNode.h>
 #include <maya/MFnTransform.h>
 #include <maya/MFnIkJoint.h>
@@ -0,0 +1,338 @@
+#include "OctreeGrid.h"
+
+static const signed char NO_LEVEL = 127;
+
+// expresses a node as a combination of free nodes, following the chains of hanging nodes
+static void expandNode(int n, const vector<vector<pair<int, QPScalarType> > > & parents, vector<vector<pair<int, QPScalarType> > > & expanded, vector<char> & done)
+{
+	if (done[n]) return;
+	map<int, QPScalarType> combination;
+	for (unsigned int k = 0; k < parents[n].size(); k++) {
+		const int p = parents[n][k].first;
+		if (parents[p].empty()) {
+			combination[p] += parents[n][k].second;
+			continue;
+		}
+		expandNode(p, parents, expanded, done);
+		for (unsigned int q = 0; q < expanded[p].size(); q++) {
+			combination[expanded[p][q].first] += parents[n][k].second * expanded[p][q].second;
+		}
+	}
+	expanded[n].assign(combination.begin(), combination.end());
+	done[n] = 1;
+}
+
+void OctreeGrid::initStructure()
+{
+	const int Xs = m_size[0];
+	const int Ys = m_size[1];
+	const int Zs = m_size[2];
+	const int numVoxels = Xs * Ys * Zs;
+#define VOXEL(x, y, z) ((x) + (y) * Xs + (z) * Xs * Ys)
+
+	// voxels that stay fine: closer than m_surfaceBand voxels to an empty voxel (or the grid border), or to a refinement point
+	vector<char> fine(numVoxels), dilated(numVoxels);
+	for (int x = 0; x < Xs; x++)
+		for (int y = 0; y < Ys; y++)
+			for (int z = 0; z < Zs; z++) fine[VOXEL(x, y, z)] = !m_boxOccupancy(x, y, z);
+	for (int axis = 0; axis < 3; axis++) { // separable dilation of the empty voxels by a cube
+		const int stride = (axis == 0) ? 1 : ((axis == 1) ? Xs : Xs * Ys);
+#pragma omp parallel for
+		for (int z = 0; z < Zs; z++) {
+			for (int y = 0; y < Ys; y++) {
+				for (int x = 0; x < Xs; x++) {
+					const int c[3] = { x, y, z };
+					char e = 0;
+					for (int d = -m_surfaceBand; d <= m_surfaceBand && !e; d++) {
+						const int w = c[axis] + d;
+						e = (w < 0 || w >= m_size[axis]) ? 1 : fine[VOXEL(x, y, z) + d * stride];
+					}
+					dilated[VOXEL(x, y, z)] = e;
+				}
+			}
+		}
+		fine.swap(dilated);
+	}
+	for (unsigned int i = 0; i < m_refinementPoints.size(); i++) {
+		RowVector3 floatIndices = (m_refinementPoints[i] - m_lowerLeft).cwiseQuotient(m_frac);
+		const int cx = (int)floor(floatIndices[0]), cy = (int)floor(floatIndices[1]), cz = (int)floor(floatIndices[2]);
+		for (int x = max(0, cx - m_surfaceBand); x <= min(Xs - 1, cx + m_surfaceBand); x++)
+			for (int y = max(0, cy - m_surfaceBand); y <= min(Ys - 1, cy + m_surfaceBand); y++)
+				for (int z = max(0, cz - m_surfaceBand); z <= min(Zs - 1, cz + m_surfaceBand); z++) fine[VOXEL(x, y, z)] = 1;
+	}
+
+	// merge 2x2x2 blocks of cells of the same level, bottom-up, as long as no touching cell is more than one level finer
+	vector<signed char> level(numVoxels);
+	for (int x = 0; x < Xs; x++)
+		for (int y = 0; y < Ys; y++)
+			for (int z = 0; z < Zs; z++) level[VOXEL(x, y, z)] = m_boxOccupancy(x, y, z) ? 0 : -1;
+	for (int l = 0; l < m_maxLevel; l++) {
+		const int s = 1 << l;
+		const int bx = (Xs + s - 1) / s, by = (Ys + s - 1) / s, bz = (Zs + s - 1) / s;
+		// per block of s^3 voxels: finest level inside, and whether it is a single mergeable cell
+		vector<signed char> minLevel(bx * by * bz, NO_LEVEL);
+		vector<char> full(bx * by * bz, 1);
+		for (int z = 0; z < Zs; z++) {
+			for (int y = 0; y < Ys; y++) {
+				for (int x = 0; x < Xs; x++) {
+					const int b = x / s + (y / s) * bx + (z / s) * bx * by;
+					const signed char lv = level[VOXEL(x, y, z)];
+					if (lv < 0 || fine[VOXEL(x, y, z)]) full[b] = 0;
+					if (lv >= 0) minLevel[b] = min(minLevel[b], lv);
+				}
+			}
+		}
+		vector<int> merged;
+		for (int cx = 0; cx + 1 < bx; cx += 2) {
+			for (int cy = 0; cy + 1 < by; cy += 2) {
+				for (int cz = 0; cz + 1 < bz; cz += 2) {
+					if ((cx + 2) * s > Xs || (cy + 2) * s > Ys || (cz + 2) * s > Zs) continue;
+					bool ok = true;
+					for (int dx = -1; dx <= 2 && ok; dx++) {
+						for (int dy = -1; dy <= 2 && ok; dy++) {
+							for (int dz = -1; dz <= 2 && ok; dz++) {
+								const int x = cx + dx, y = cy + dy, z = cz + dz;
+								if (x < 0 || x >= bx || y < 0 || y >= by || z < 0 || z >= bz) continue;
+								const int b = x + y * bx + z * bx * by;
+								const bool child = (dx == 0 || dx == 1) && (dy == 0 || dy == 1) && (dz == 0 || dz == 1);
+								if (child) ok = full[b] && minLevel[b] == l;
+								else ok = (minLevel[b] >= l);
+							}
+						}
+					}
+					if (ok) {
+						merged.push_back(cx * s);
+						merged.push_back(cy * s);
+						merged.push_back(cz * s);
+					}
+				}
+			}
+		}
+		if (merged.empty()) break;
+		for (unsigned int m = 0; m < merged.size(); m += 3) {
+			for (int x = merged[m]; x < merged[m] + 2 * s; x++)
+				for (int y = merged[m + 1]; y < merged[m + 1] + 2 * s; y++)
+					for (int z = merged[m + 2]; z < merged[m + 2] + 2 * s; z++) level[VOXEL(x, y, z)] = l + 1;
+		}
+	}
+
+	// cells (the boxes of the grid), numbered in the same x, y, z order as the voxels
+	vector<int> origins, levels;
+	for (int x = 0; x < Xs; x++) {
+		for (int y = 0; y < Ys; y++) {
+			for (int z = 0; z < Zs; z++) {
+				const int lv = level[VOXEL(x, y, z)];
+				if (lv < 0) continue;
+				const int mask = (1 << lv) - 1;
+				if ((x & mask) || (y & mask) || (z & mask)) continue;
+				origins.push_back(x); origins.push_back(y); origins.push_back(z);
+				levels.push_back(lv);
+			}
+		}
+	}
+	nnzBoxes = levels.size();
+	m_cellOrigin.resize(nnzBoxes, 3);
+	m_cellLevel.resize(nnzBoxes);
+	m_boxArray.setAllTo(-1);
+	for (int c = 0; c < nnzBoxes; c++) {
+		m_cellOrigin.row(c) = RowVector3i(origins[3 * c], origins[3 * c + 1], origins[3 * c + 2]);
+		m_cellLevel[c] = levels[c];
+		const int S = 1 << levels[c];
+		for (int x = 0; x < S; x++)
+			for (int y = 0; y < S; y++)
+				for (int z = 0; z < S; z++) m_boxArray(origins[3 * c] + x, origins[3 * c + 1] + y, origins[3 * c + 2] + z) = c;
+	}
+#undef VOXEL
+
+	// nodes: corners of the cells
+	m_nodeArray.setAllTo(-1);
+	for (int c = 0; c < nnzBoxes; c++) {
+		const int S = 1 << m_cellLevel[c];
+		for (int i = 0; i < 8; ++i) {
+			m_nodeArray(m_cellOrigin(c, 0) + S * (i / 4), m_cellOrigin(c, 1) + S * ((i / 2) % 2), m_cellOrigin(c, 2) + S * (i % 2)) = 0;
+		}
+	}
+	vector<RowVector3i> lattice;
+	for (int x = 0; x < Xs + 1; x++) {
+		for (int y = 0; y < Ys + 1; y++) {
+			for (int z = 0; z < Zs + 1; z++) {
+				if (m_nodeArray(x, y, z) == -1) continue;
+				m_nodeArray(x, y, z) = lattice.size();
+				lattice.push_back(RowVector3i(x, y, z));
+			}
+		}
+	}
+	const int numNodes = lattice.size();
+
+	// hanging nodes: on the middle of an edge (2 parents) or a face (4 parents) of a larger cell
+	vector<vector<pair<int, QPScalarType> > > parents(numNodes);
+	for (int c = 0; c < nnzBoxes; c++) {
+		if (m_cellLevel[c] == 0) continue;
+		const int h = (1 << m_cellLevel[c]) / 2;
+		for (int a = 0; a < 3; a++) {
+			for (int b = 0; b < 3; b++) {
+				for (int d = 0; d < 3; d++) {
+					const int k = (a == 1) + (b == 1) + (d == 1);
+					if (k == 0 || k == 3) continue;
+					const int n = m_nodeArray(m_cellOrigin(c, 0) + a * h, m_cellOrigin(c, 1) + b * h, m_cellOrigin(c, 2) + d * h);
+					if (n == -1 || !parents[n].empty()) continue;
+					for (int p = 0; p < (1 << k); p++) { // each middle coordinate goes to either end
+						int bit = 0;
+						const int pa = (a == 1) ? 2 * ((p >> bit++) & 1) : a;
+						const int pb = (b == 1) ? 2 * ((p >> bit++) & 1) : b;
+						const int pd = (d == 1) ? 2 * ((p >> bit++) & 1) : d;
+						const int parent = m_nodeArray(m_cellOrigin(c, 0) + pa * h, m_cellOrigin(c, 1) + pb * h, m_cellOrigin(c, 2) + pd * h);
+						parents[n].push_back(make_pair(parent, (QPScalarType)1.0 / (1 << k)));
+					}
+				}
+			}
+		}
+	}
+	vector<vector<pair<int, QPScalarType> > > expanded(numNodes);
+	vector<char> done(numNodes, 0);
+	for (int n = 0; n < numNodes; n++) {
+		if (!parents[n].empty()) expandNode(n, parents, expanded, done);
+	}
+
+	// free nodes first, then the hanging ones
+	vector<int> newId(numNodes);
+	m_numFreeNodes = 0;
+	for (int n = 0; n < numNodes; n++) if (parents[n].empty()) newId[n] = m_numFreeNodes++;
+	int numHanging = 0;
+	for (int n = 0; n < numNodes; n++) if (!parents[n].empty()) newId[n] = m_numFreeNodes + numHanging++;
+	nnzNodes = numNodes;
+
+	m_nodes.assign(nnzNodes, RowVector3(0, 0, 0));
+	for (int n = 0; n < numNodes; n++) {
+		const RowVector3i & q = lattice[n];
+		m_nodeArray(q[0], q[1], q[2]) = newId[n];
+		m_nodes[newId[n]] = m_lowerLeft + m_frac.cwiseProduct(RowVector3(q[0], q[1], q[2]));
+	}
+	m_boxNodes.setConstant(nnzBoxes, 8, -1);
+	for (int c = 0; c < nnzBoxes; c++) {
+		const int S = 1 << m_cellLevel[c];
+		for (int i = 0; i < 8; ++i) {
+			m_boxNodes(c, i) = m_nodeArray(m_cellOrigin(c, 0) + S * (i / 4), m_cellOrigin(c, 1) + S * ((i / 2) % 2), m_cellOrigin(c, 2) + S * (i % 2));
+		}
+	}
+	// the uniform neighbourhoods have no meaning across levels
+	m_nodeNodes.setConstant(nnzNodes, 6, -1);
+	m_boxBoxes.setConstant(nnzBoxes, 6, -1);
+
+	vector<QPSparseMatrixTriplet> P_MEL;
+	P_MEL.reserve(nnzNodes);
+	for (int n = 0; n < numNodes; n++) {
+		if (parents[n].empty()) P_MEL.push_back(QPSparseMatrixTriplet(newId[n], newId[n], 1.0));
+		else {
+			for (unsigned int k = 0; k < expanded[n].size(); k++) {
+				P_MEL.push_back(QPSparseMatrixTriplet(newId[n], newId[expanded[n][k].first], expanded[n][k].second));
+			}
+		}
+	}
+	m_prolongation.resize(nnzNodes, m_numFreeNodes);
+	m_prolongation.setFromTriplets(P_MEL.begin(), P_MEL.end());
+
+	cout << "BBW Solver: octree with " << nnzBoxes << " cells, " << nnzNodes << " nodes (" << m_numFreeNodes << " unknowns)" << endl;
+}
+
+int OctreeGrid::getBoxContainingPoint(const RowVector3 & P, RowVector3 & t) const
+{
+	RowVector3 voxelT;
+	const int idCell = BoxGrid::getBoxContainingPoint(P, voxelT);
+	if (idCell == -1) return -1;
+	cellCoords(idCell, P, t);
+	return idCell;
+}
+
+int OctreeGrid::getNodeClosestToPoint(const RowVector3 & P) const
+{
+	RowVector3 t;
+	const int idCell = getBoxContainingPoint(P, t);
+	if (idCell == -1) return -1;
+	return closestFreeNode(idCell, t);
+}
+
+void OctreeGrid::getBoxesContainingPoints(const PointMatrixType & P, PointLocations & loc) const
+{
+	BoxGrid::getBoxesContainingPoints(P, loc);
+	const int numPoints = P.rows();
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < numPoints; ++v) {
+		const int idCell = loc.boxes[v];
+		if (idCell == -1) continue;
+		RowVector3 t;
+		cellCoords(idCell, P.row(v), t);
+		for (int k = 0; k < 3; k++) loc.t[k][v] = t[k];
+	}
+}
+
+void OctreeGrid::getNodesClosestToPoints(const PointMatrixType & P, vector<int> & nodes, vector<int> & outside) const
+{
+	PointLocations loc;
+	getBoxesContainingPoints(P, loc);
+	const int numPoints = P.rows();
+	nodes.assign(numPoints, -1);
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < numPoints; ++v) {
+		const int idCell = loc.boxes[v];
+		if (idCell != -1) nodes[v] = closestFreeNode(idCell, RowVector3(loc.t[0][v], loc.t[1][v], loc.t[2][v]));
+	}
+	outside.clear();
+	for (int v = 0; v < numPoints; ++v) if (nodes[v] == -1) outside.push_back(v);
+}
+
+// coordinates of P local to the whole cell
+void OctreeGrid::cellCoords(int idCell, const RowVector3 & P, RowVector3 & t) const
+{
+	const RowVector3 floatIndices = (P - m_lowerLeft).cwiseQuotient(m_frac);
+	const ScalarType S = (ScalarType)(1 << m_cellLevel[idCell]);
+	for (int k = 0; k < 3; k++) t[k] = (floatIndices[k] - m_cellOrigin(idCell, k)) / S;
+}
+
+int OctreeGrid::closestFreeNode(int idCell, const RowVector3 & t) const
+{
+	int closest = -1;
+	ScalarType closestDist = numeric_limits<ScalarType>::max();
+	for (int i = 0; i < 8; ++i) {
+		const int idNode = m_boxNodes(idCell, i);
+		if (idNode >= m_numFreeNodes) continue; // hanging nodes are not unknowns
+		const ScalarType d = (t - RowVector3(i / 4, (i / 2) % 2, i % 2)).squaredNorm();
+		if (d < closestDist) {
+			closestDist = d;
+			closest = idNode;
+		}
+	}
+	return closest;
+}
+
+void OctreeGrid::biharmonic(QPSparseMatrix & L2) const
+{
+	// stiffness of a unit trilinear cube between corners i and j, by number of differing coordinates
+	const QPScalarType unitStiffness[4] = { 1.0 / 3.0, 0.0, -1.0 / 12.0, -1.0 / 12.0 };
+	vector<QPSparseMatrixTriplet> K_MEL;
+	K_MEL.reserve(nnzBoxes * 64);
+	QPVectorX mass;
+	mass.setZero(nnzNodes);
+	for (int c = 0; c < nnzBoxes; c++) {
+		const QPScalarType h = (1 << m_cellLevel[c]) * m_frac[0];
+		for (int i = 0; i < 8; ++i) {
+			mass[m_boxNodes(c, i)] += h * h * h / 8.0;
+			for (int j = 0; j < 8; ++j) {
+				const int diff = ((i ^ j) & 1) + (((i ^ j) >> 1) & 1) + (((i ^ j) >> 2) & 1);
+				if (unitStiffness[diff] != 0) K_MEL.push_back(QPSparseMatrixTriplet(m_boxNodes(c, i), m_boxNodes(c, j), h * unitStiffness[diff]));
+			}
+		}
+	}
+	QPSparseMatrix K(nnzNodes, nnzNodes);
+	K.setFromTriplets(K_MEL.begin(), K_MEL.end());
+	const QPSparseMatrix Pt = m_prolongation.transpose();
+	const QPSparseMatrix Kf = Pt * K * m_prolongation;
+	const QPVectorX massf = Pt * mass;
+	L2 = Kf * massf.cwiseInverse().asDiagonal() * Kf;
+}
+
+void OctreeGrid::prolongateWeights(QPMatrixXX & W) const
+{
+	QPMatrixXX Wf = W;
+	W = m_prolongation * Wf;
+}
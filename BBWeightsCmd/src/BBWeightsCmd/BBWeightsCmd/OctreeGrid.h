@@ -0,0 +1,47 @@
+#ifndef __OCTREEGRID_H
+#define __OCTREEGRID_H
+
+#include "BoxGrid.h"
+
+// Adaptive discretization of the BoxGrid domain: away from the mesh surface and the handles, the boxes of the
+// uniform grid are merged into cubic cells up to 2^maxLevel boxes wide, with at most a factor 2 between touching
+// cells. The boxes of the base class become these cells (m_boxArray maps every voxel to the cell covering it).
+// Nodes in the middle of an edge or a face of a larger neighbouring cell ("hanging" nodes) are not unknowns:
+// they are interpolated from the corners of that edge/face, which keeps the trilinear weight field continuous.
+// Free nodes are numbered first, so the QP only involves the first getNumUnknowns() nodes.
+class OctreeGrid : public BoxGrid {
+
+public:
+	OctreeGrid(int maxLevel, int surfaceBand = 2) : m_maxLevel(maxLevel), m_surfaceBand(surfaceBand), m_numFreeNodes(0) {}
+
+	// the cells containing these points (e.g. joints) stay at the finest level
+	void setRefinementPoints(const vector<RowVector3> & points) { m_refinementPoints = points; }
+	const vector<RowVector3> & getRefinementPoints() const { return m_refinementPoints; }
+
+	virtual void initStructure();
+	virtual int getBoxContainingPoint(const RowVector3 & P, RowVector3 & t) const;
+	virtual int getNodeClosestToPoint(const RowVector3 & P) const;
+	virtual void getBoxesContainingPoints(const PointMatrixType & P, PointLocations & loc) const;
+	virtual void getNodesClosestToPoints(const PointMatrixType & P, vector<int> & nodes, vector<int> & outside) const;
+
+	virtual int getNumUnknowns() const { return m_numFreeNodes; }
+
+protected:
+	// trilinear finite elements on the cells, hanging nodes eliminated: Q = K' M'^-1 K' with K' = P^T K P, M' = P^T M
+	virtual void biharmonic(QPSparseMatrix & L2) const;
+	// no hierarchy of coarser octrees: no stencil operator for mg and no cascade (CheckGridOptions warns about them)
+	virtual QPoperator * biharmonicOperator(int /*levels*/) const { return NULL; }
+	virtual bool coarseSolution(const vector<RowVector3> & /*handles*/, QPMatrixXX & /*W*/) const { return false; }
+	virtual void prolongateWeights(QPMatrixXX & W) const;
+	void cellCoords(int idCell, const RowVector3 & P, RowVector3 & t) const;
+	int closestFreeNode(int idCell, const RowVector3 & t) const;
+
+	int m_maxLevel, m_surfaceBand;
+	vector<RowVector3> m_refinementPoints;
+	MatrixX3i m_cellOrigin; // lowest voxel of each cell
+	VectorXi m_cellLevel; // cells are 2^level voxels wide
+	QPSparseMatrix m_prolongation; // all nodes x free nodes
+	int m_numFreeNodes;
+};
+
+#endif
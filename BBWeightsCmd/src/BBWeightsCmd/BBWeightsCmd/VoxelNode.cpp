@@ -42,7 +42,10 @@ MStatus VoxelNode::compute(const MPlug& plug, MDataBlock& data)
 		MFnPointArrayData voxelsHandle(data.outputValue(VoxelNode::outVoxels).data());
 		MPointArray voxels = voxelsHandle.array();
 
-		Voxelize(inMesh, numVoxels[0], numVoxels[1], numVoxels[2], voxels);
+		// the GL path needs a context and packs the depth bits in 128 bit colors
+		const bool useGL = (MGlobal::mayaState() == MGlobal::kInteractive) && numVoxels[0] <= 128 && numVoxels[1] <= 128 && numVoxels[2] <= 128;
+		if (useGL) Voxelize(inMesh, numVoxels[0], numVoxels[1], numVoxels[2], voxels);
+		else VoxelizeCPU(inMesh, numVoxels[0], numVoxels[1], numVoxels[2], voxels);
 
 	} 
 	else {
@@ -91,7 +94,7 @@ MStatus VoxelNode::initialize()
 	voxelRes = nAttr.create("voxelResolution", "vr", MFnNumericData::kInt, 16, &stat);
 	if (!stat) return stat;
 	nAttr.setMin(1);
-	nAttr.setMax(32);
+	nAttr.setMax(512);
 	nAttr.setWritable(true);
 	nAttr.setStorable(true);
 
@@ -129,6 +132,16 @@ MStatus VoxelNode::initialize()
 	return MS::kSuccess;
 }
 
+bool VoxelNode::VoxelizeCPU(const MFnMesh& mesh, int resX, int resY, int resZ, MPointArray& voxels) {
+
+	resX = std::max(1, resX);
+	resY = std::max(1, resY);
+	resZ = std::max(1, resZ);
+
+	Array3D<bool> voxArray(resX, resY, resZ);
+	return VoxelizeMeshCPU(mesh, resX, resY, resZ, voxels, voxArray);
+}
+
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
 
 bool VoxelNode::Voxelize(const MFnMesh& mesh, int resX, int resY, int resZ, MPointArray& voxels) {
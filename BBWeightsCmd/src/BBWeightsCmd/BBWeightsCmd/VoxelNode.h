@@ -1,6 +1,7 @@
 #pragma once
 
 #include "headers.h"
+#include "VoxelizerMaya.h"
 
 
 /* ==========================================
@@ -46,4 +47,7 @@ private:
 
 	static bool Voxelize(const MFnMesh& inMesh, int resX, int resY, int resZ,
 		MPointArray& voxels);
+	// same output computed on the CPU, used when there is no GL context (batch mode)
+	static bool VoxelizeCPU(const MFnMesh& inMesh, int resX, int resY, int resZ,
+		MPointArray& voxels);
 };
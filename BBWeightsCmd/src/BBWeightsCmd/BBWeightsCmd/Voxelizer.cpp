@@ -0,0 +1,91 @@
+#include "Voxelizer.h"
+
+// edge function of the 2D segment a->b evaluated at p (> 0 on the left side)
+static inline double edgeFunction(const double a[2], const double b[2], const double p[2])
+{
+	return (b[0] - a[0]) * (p[1] - a[1]) - (b[1] - a[1]) * (p[0] - a[0]);
+}
+
+// top-left fill convention for counter-clockwise triangles: a sample lying exactly on an edge shared by two
+// triangles is counted by exactly one of them, so the parity stays correct on watertight meshes
+static inline bool edgeIncluded(double w, const double a[2], const double b[2])
+{
+	if (w != 0) return w > 0;
+	return (b[1] < a[1]) || (a[1] == b[1] && b[0] < a[0]);
+}
+
+bool VoxelizeSolid(const vector<float>& points, const vector<int>& triangles, const float bmin[3], const float bmax[3],
+	int resX, int resY, int resZ, Array3D<bool>& m_voxArray)
+{
+	if (resX < 1 || resY < 1 || resZ < 1) return false;
+	assert(m_voxArray.getSize(0) == resX && m_voxArray.getSize(1) == resY && m_voxArray.getSize(2) == resZ);
+
+	const double deltaX = (bmax[0] - bmin[0]) / resX;
+	const double deltaY = (bmax[1] - bmin[1]) / resY;
+	const double deltaZ = (bmax[2] - bmin[2]) / resZ;
+	if (deltaX <= 0 || deltaY <= 0 || deltaZ <= 0) return false;
+	const int nbTriangles = (int)triangles.size() / 3;
+
+	// bin the triangles by the rows of column centers they may cover
+	vector<vector<int> > rows(resY);
+	for (int t = 0; t < nbTriangles; t++) {
+		float ymin = points[3 * triangles[3 * t] + 1], ymax = ymin;
+		for (int k = 1; k < 3; k++) {
+			const float y = points[3 * triangles[3 * t + k] + 1];
+			ymin = min(ymin, y);
+			ymax = max(ymax, y);
+		}
+		const int y0 = max(0, (int)ceil((ymin - bmin[1]) / deltaY - 0.5));
+		const int y1 = min(resY - 1, (int)floor((ymax - bmin[1]) / deltaY - 0.5));
+		for (int y = y0; y <= y1; y++) rows[y].push_back(t);
+	}
+
+#pragma omp parallel
+	{
+		vector<vector<double> > crossings(resX);
+#pragma omp for schedule(dynamic, 1)
+		for (int y = 0; y < resY; y++) {
+			for (int x = 0; x < resX; x++) crossings[x].clear();
+			const double py = bmin[1] + (y + 0.5) * deltaY;
+			for (unsigned int r = 0; r < rows[y].size(); r++) {
+				const int t = rows[y][r];
+				double p[3][3];
+				for (int k = 0; k < 3; k++) {
+					for (int c = 0; c < 3; c++) p[k][c] = points[3 * triangles[3 * t + k] + c];
+				}
+				double area = (p[1][0] - p[0][0]) * (p[2][1] - p[0][1]) - (p[1][1] - p[0][1]) * (p[2][0] - p[0][0]);
+				if (area == 0) continue; // triangle seen edge-on
+				if (area < 0) { // make it counter-clockwise
+					for (int c = 0; c < 3; c++) swap(p[1][c], p[2][c]);
+					area = -area;
+				}
+				const double xmin = min(p[0][0], min(p[1][0], p[2][0]));
+				const double xmax = max(p[0][0], max(p[1][0], p[2][0]));
+				const int x0 = max(0, (int)ceil((xmin - bmin[0]) / deltaX - 0.5));
+				const int x1 = min(resX - 1, (int)floor((xmax - bmin[0]) / deltaX - 0.5));
+				for (int x = x0; x <= x1; x++) {
+					const double s[2] = { bmin[0] + (x + 0.5) * deltaX, py };
+					const double w0 = edgeFunction(p[1], p[2], s);
+					const double w1 = edgeFunction(p[2], p[0], s);
+					const double w2 = edgeFunction(p[0], p[1], s);
+					if (!edgeIncluded(w0, p[1], p[2]) || !edgeIncluded(w1, p[2], p[0]) || !edgeIncluded(w2, p[0], p[1])) continue;
+					crossings[x].push_back((w0 * p[0][2] + w1 * p[1][2] + w2 * p[2][2]) / area);
+				}
+			}
+			// fill by parity: a voxel is inside if an odd number of surfaces lie below its lower face
+			for (int x = 0; x < resX; x++) {
+				vector<double> & zc = crossings[x];
+				if (zc.empty()) continue;
+				sort(zc.begin(), zc.end());
+				unsigned int below = 0;
+				for (int z = 0; z < resZ; z++) {
+					const double sz = bmin[2] + z * deltaZ;
+					while (below < zc.size() && zc[below] <= sz) below++;
+					if (below == zc.size()) break;
+					if (below % 2 == 1) m_voxArray.set(x, y, z, true);
+				}
+			}
+		}
+	}
+	return true;
+}
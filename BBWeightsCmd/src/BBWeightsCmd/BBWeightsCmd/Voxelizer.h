@@ -0,0 +1,17 @@
+#ifndef __VOXELIZER_H
+#define __VOXELIZER_H
+
+#include "STL_inc.h"
+#include "Array3D.h"
+
+// CPU solid voxelization of a closed triangle mesh (no OpenGL context needed).
+// A ray is cast along z through the center of every (x, y) column and the voxels are filled by crossing parity,
+// which is what the GL XOR-blend voxelizer computes: the column is sampled at the lower z face of each voxel.
+// points are xyz triplets, triangles are vertex index triplets (as returned by MFnMesh::getTriangles),
+// bmin/bmax is the box mapped onto the resX x resY x resZ grid. Occupied voxels are set in m_voxArray,
+// which must already be initialized (cleared) with the grid size. There is no limit on the resolution.
+// Columns are processed in parallel.
+bool VoxelizeSolid(const vector<float>& points, const vector<int>& triangles, const float bmin[3], const float bmax[3],
+	int resX, int resY, int resZ, Array3D<bool>& m_voxArray);
+
+#endif
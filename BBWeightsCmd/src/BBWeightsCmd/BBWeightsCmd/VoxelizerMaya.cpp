@@ -0,0 +1,42 @@
+#include "VoxelizerMaya.h"
+#include "Voxelizer.h"
+
+bool VoxelizeMeshCPU(const MFnMesh& mesh, int resX, int resY, int resZ, MPointArray& voxels, Array3D<bool>& m_voxArray)
+{
+	MFloatPointArray meshPoints;
+	mesh.getPoints(meshPoints, MSpace::kWorld);
+	MIntArray triangleCounts, triVertices;
+	mesh.getTriangles(triangleCounts, triVertices);
+
+	MBoundingBox bounds;
+	vector<float> points(3 * meshPoints.length());
+	for (unsigned int i = 0; i < meshPoints.length(); i++) {
+		points[3 * i] = meshPoints[i].x;
+		points[3 * i + 1] = meshPoints[i].y;
+		points[3 * i + 2] = meshPoints[i].z;
+		bounds.expand(meshPoints[i]);
+	}
+	vector<int> triangles(triVertices.length());
+	for (unsigned int i = 0; i < triVertices.length(); i++) triangles[i] = triVertices[i];
+
+	const float bmin[3] = { (float)bounds.min().x, (float)bounds.min().y, (float)bounds.min().z };
+	const float bmax[3] = { (float)bounds.max().x, (float)bounds.max().y, (float)bounds.max().z };
+	if (!VoxelizeSolid(points, triangles, bmin, bmax, resX, resY, resZ, m_voxArray)) return false;
+
+	// dump voxels (given as a pair of min/max points)
+	voxels.clear();
+	const float deltaX = (float)bounds.width() / resX;
+	const float deltaY = (float)bounds.height() / resY;
+	const float deltaZ = (float)bounds.depth() / resZ;
+	for (int z = 0; z < resZ; z++) {
+		for (int y = 0; y < resY; y++) {
+			for (int x = 0; x < resX; x++) {
+				if (!m_voxArray(x, y, z)) continue;
+				MPoint bbMin(bmin[0] + x * deltaX, bmin[1] + y * deltaY, bmin[2] + z * deltaZ);
+				voxels.append(bbMin);
+				voxels.append(MPoint(bbMin.x + deltaX, bbMin.y + deltaY, bbMin.z + deltaZ));
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,12 @@
+#ifndef __VOXELIZERMAYA_H
+#define __VOXELIZERMAYA_H
+
+#include "MAYA_inc.h"
+#include "STL_inc.h"
+#include "Array3D.h"
+
+// VoxelizeSolid on the world points of a Maya mesh, over its bounding box (the GL voxelizer's domain).
+// m_voxArray must already be initialized with the grid size; the voxels are dumped as min/max point pairs.
+bool VoxelizeMeshCPU(const MFnMesh& mesh, int resX, int resY, int resZ, MPointArray& voxels, Array3D<bool>& m_voxArray);
+
+#endif
@@ -2,6 +2,7 @@
 #define __WEIGHTS_H
 
 #include "STL_inc.h"
+#include "EIGEN_inc.h"
 
 // simple class to store the weights
 class Weights {
@@ -21,7 +22,8 @@ public:
 		m_coords.push_back(w);
 		m_sumCoords += w;
 	}
-	vector<ScalarType> getCoords() const{ return m_coords; }
+	const vector<ScalarType> & getCoords() const{ return m_coords; }
+	int getNumCoords() const { return m_coords.size(); }
 	ScalarType getCoord(int b_id) const { return m_coords[b_id]; }
 	void setCoord(int b_id, ScalarType w){ m_coords[b_id] = w; }
 	void setSumCoords(){ m_sumCoords = 1.0; }
@@ -34,4 +36,107 @@ public:
 
 };
 
+// weights of all the grid nodes in one contiguous block, one row of handles per node.
+// Storage precision is chosen at compile time: ScalarType by default, float with BBW_WEIGHTS_FLOAT,
+// 16 bits fixed point (w * 65535, weights lie in [0, 1]) with BBW_WEIGHTS_UINT16.
+#if defined(BBW_WEIGHTS_UINT16) && defined(BBW_WEIGHTS_FLOAT)
+#error "BBW_WEIGHTS_UINT16 and BBW_WEIGHTS_FLOAT are exclusive"
+#endif
+class WeightMatrix {
+
+public:
+#if defined(BBW_WEIGHTS_UINT16)
+	typedef unsigned short StorageType;
+	static StorageType encode(ScalarType w) { return (StorageType)(min(max(w, (ScalarType)0), (ScalarType)1) * 65535 + 0.5); }
+	static ScalarType decode(StorageType w) { return w * (ScalarType)(1.0 / 65535); }
+#elif defined(BBW_WEIGHTS_FLOAT)
+	typedef float StorageType;
+	static StorageType encode(ScalarType w) { return (StorageType)w; }
+	static ScalarType decode(StorageType w) { return w; }
+#else
+	typedef ScalarType StorageType;
+	static StorageType encode(ScalarType w) { return w; }
+	static ScalarType decode(StorageType w) { return w; }
+#endif
+
+	WeightMatrix() : m_rows(0), m_cols(0) {}
+
+	void setZero(int numNodes, int numHandles) {
+		m_rows = numNodes;
+		m_cols = numHandles;
+		m_data.assign((size_t)numNodes * numHandles, encode(0));
+	}
+	void clear() { m_rows = m_cols = 0; m_data.clear(); }
+
+	int rows() const { return m_rows; }
+	int cols() const { return m_cols; }
+	ScalarType get(int idNode, int idHandle) const { return decode(m_data[(size_t)idNode * m_cols + idHandle]); }
+	void set(int idNode, int idHandle, ScalarType w) { m_data[(size_t)idNode * m_cols + idHandle] = encode(w); }
+	const StorageType * row(int idNode) const { return &m_data[(size_t)idNode * m_cols]; }
+	StorageType * row(int idNode) { return &m_data[(size_t)idNode * m_cols]; }
+	size_t memorySize() const { return m_data.size() * sizeof(StorageType); }
+
+private:
+	int m_rows, m_cols;
+	vector<StorageType> m_data;
+};
+
+// per vertex influences in compressed rows: the influences of vertex v are
+// influences[offsets[v] .. offsets[v + 1]), sorted by decreasing weight, with their weights summing to 1
+class SparseWeights {
+
+public:
+	vector<int> offsets; // numVertices + 1
+	vector<int> influences;
+	vector<ScalarType> weights;
+
+	int getNumVertices() const { return offsets.empty() ? 0 : (int)offsets.size() - 1; }
+	int getNumInfluences(int v) const { return offsets[v + 1] - offsets[v]; }
+
+	// keeps the maxInfluences largest weights of each row (all of them if maxInfluences <= 0) that are above
+	// epsilon (at least the largest one), and renormalizes them. Rows with no positive weight stay empty,
+	// their number is returned
+	int build(const RowMatrixXX & dense, int maxInfluences, ScalarType epsilon) {
+		return build(dense.data(), dense.rows(), dense.cols(), maxInfluences, epsilon);
+	}
+	// same from a row-major numVertices x numBones block (e.g. mapped from a cache file)
+	int build(const ScalarType * dense, int numVertices, int numBones, int maxInfluences, ScalarType epsilon) {
+		const int K = (maxInfluences <= 0) ? numBones : min(maxInfluences, numBones);
+		offsets.assign(numVertices + 1, 0);
+		vector<int> selected((size_t)numVertices * K);
+		int empty = 0;
+#pragma omp parallel reduction(+:empty)
+		{
+			vector<int> order(numBones);
+#pragma omp for
+			for (int v = 0; v < numVertices; v++) {
+				const ScalarType * w = dense + (size_t)v * numBones;
+				for (int j = 0; j < numBones; j++) order[j] = j;
+				partial_sort(order.begin(), order.begin() + K, order.end(), [w](int a, int b) { return w[a] > w[b] || (w[a] == w[b] && a < b); });
+				int n = (K > 0 && w[order[0]] > 0) ? 1 : 0;
+				while (n > 0 && n < K && w[order[n]] > epsilon) n++;
+				if (n == 0) empty++;
+				copy(order.begin(), order.begin() + n, selected.begin() + (size_t)v * K);
+				offsets[v + 1] = n;
+			}
+		}
+		for (int v = 0; v < numVertices; v++) offsets[v + 1] += offsets[v];
+		influences.resize(offsets[numVertices]);
+		weights.resize(offsets[numVertices]);
+#pragma omp parallel for
+		for (int v = 0; v < numVertices; v++) {
+			const ScalarType * w = dense + (size_t)v * numBones;
+			const int n = offsets[v + 1] - offsets[v];
+			ScalarType sum = 0;
+			for (int k = 0; k < n; k++) sum += w[selected[(size_t)v * K + k]];
+			for (int k = 0; k < n; k++) {
+				const int j = selected[(size_t)v * K + k];
+				influences[offsets[v] + k] = j;
+				weights[offsets[v] + k] = w[j] / sum;
+			}
+		}
+		return empty;
+	}
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "activeset_solver.h"
+
+ActiveSetInterface::ActiveSetInterface()
+{
+	m_variableBounds = 1;
+	m_maxIter = 100;
+	m_tol = 1e-8;
+	m_reg = 0;
+}
+
+ActiveSetInterface::~ActiveSetInterface()
+{
+}
+
+bool ActiveSetInterface::setup(const QPSparseMatrix &Q, const QPSparseMatrix &A, int variableBounds)
+{
+	assert(Q.rows() == A.cols() && Q.cols() == A.cols());
+	m_Q = Q;
+	m_Q.makeCompressed();
+	m_variableBounds = variableBounds;
+
+	m_conVar.assign(A.rows(), -1);
+	m_conCoeff.assign(A.rows(), 0);
+	for (int k = 0; k < A.outerSize(); ++k) {
+		for (QPSparseMatrix::InnerIterator it(A, k); it; ++it) {
+			if (it.value() == 0) continue;
+			if (m_conVar[it.row()] != -1) {
+				cout << "Error : active set solver only supports constraints on a single variable" << endl;
+				return false;
+			}
+			m_conVar[it.row()] = it.col();
+			m_conCoeff[it.row()] = it.value();
+		}
+	}
+
+	QPScalarType maxDiag = 0;
+	for (int i = 0; i < m_Q.rows(); ++i) maxDiag = max(maxDiag, (QPScalarType)fabs(m_Q.coeff(i, i)));
+	m_reg = 1e-12 * maxDiag;
+	return true;
+}
+
+QPsession * ActiveSetInterface::createSession(LOGtype logtype, int /*numThreads*/) const
+{
+	return new ActiveSetSession(*this, logtype);
+}
+
+ActiveSetSession::ActiveSetSession(const ActiveSetInterface &as, QPinterface::LOGtype logtype) : m_as(as)
+{
+	m_logtype = logtype;
+}
+
+bool ActiveSetSession::solve(QPVectorX &X, const QPVectorX &b, const QPVectorX *X0)
+{
+	const QPSparseMatrix & Q = m_as.m_Q;
+	const int N = Q.rows();
+	const bool bounded = (m_as.m_variableBounds == 1);
+	const QPScalarType tol = m_as.m_tol;
+	assert(b.rows() == (int)m_as.m_conVar.size());
+
+	vector<char> state(N, FREE);
+	X.setZero(N);
+	if (bounded && X0 != NULL && X0->rows() == N) {
+		for (int i = 0; i < N; ++i) {
+			if ((*X0)[i] <= tol) state[i] = LOWER;
+			else if ((*X0)[i] >= 1.0 - tol) { state[i] = UPPER; X[i] = 1.0; }
+		}
+	}
+	for (unsigned int r = 0; r < m_as.m_conVar.size(); ++r) {
+		const int v = m_as.m_conVar[r];
+		if (v == -1) continue;
+		state[v] = KNOWN;
+		X[v] = b[r] / m_as.m_conCoeff[r];
+	}
+
+	QPVectorX rhs, xFree, g(N);
+	vector<int> freeVars, freePos(N);
+	int iter = 0;
+	bool converged = false;
+	for (; iter < m_as.m_maxIter; ++iter) {
+		// equality-constrained subproblem on the free variables only: Q_FF x_F = -Q_FC x_C,
+		// factorized on its own so that the cost shrinks with the active set
+		freeVars.clear();
+		for (int i = 0; i < N; ++i) {
+			freePos[i] = (state[i] == FREE) ? (int)freeVars.size() : -1;
+			if (state[i] == FREE) freeVars.push_back(i);
+		}
+		const int F = freeVars.size();
+		const int * outer = Q.outerIndexPtr();
+		const int * inner = Q.innerIndexPtr();
+		const QPScalarType * qVal = Q.valuePtr();
+		m_Qf.resize(F, F);
+		int nnz = 0;
+		for (int c = 0; c < F; ++c) {
+			const int j = freeVars[c];
+			for (int p = outer[j]; p < outer[j + 1]; ++p) if (freePos[inner[p]] != -1) nnz++;
+		}
+		m_Qf.resizeNonZeros(nnz);
+		rhs.setZero(F);
+		nnz = 0;
+		for (int c = 0; c < F; ++c) {
+			const int j = freeVars[c];
+			m_Qf.outerIndexPtr()[c] = nnz;
+			for (int p = outer[j]; p < outer[j + 1]; ++p) {
+				const int r = freePos[inner[p]];
+				if (r == -1) continue;
+				m_Qf.innerIndexPtr()[nnz] = r;
+				m_Qf.valuePtr()[nnz++] = qVal[p] + ((r == c) ? m_as.m_reg : 0);
+			}
+		}
+		m_Qf.outerIndexPtr()[F] = nnz;
+		for (int j = 0; j < N; ++j) {
+			if (state[j] == FREE || X[j] == 0) continue;
+			for (int p = outer[j]; p < outer[j + 1]; ++p) {
+				const int r = freePos[inner[p]];
+				if (r != -1) rhs[r] -= qVal[p] * X[j];
+			}
+		}
+
+		if (F > 0) {
+			// the pattern changes with the active set; its ordering costs little next to the numeric factorization
+			m_ldlt.compute(m_Qf);
+			if (m_ldlt.info() != Eigen::Success) {
+				printf("solveQP failed\n");
+				return false;
+			}
+			xFree = m_ldlt.solve(rhs);
+			for (int c = 0; c < F; ++c) X[freeVars[c]] = xFree[c];
+		}
+		if (!bounded) { converged = true; break; }
+
+		// add the violated bounds
+		int changes = 0;
+		vector<char> added(N, 0);
+		for (int i = 0; i < N; ++i) {
+			if (state[i] != FREE) continue;
+			if (X[i] < -tol) { state[i] = LOWER; X[i] = 0; added[i] = 1; changes++; }
+			else if (X[i] > 1.0 + tol) { state[i] = UPPER; X[i] = 1.0; added[i] = 1; changes++; }
+		}
+		// release the bounds whose multiplier (the gradient 2Qx) pushes the variable back inside
+		g = Q * X;
+		for (int i = 0; i < N; ++i) {
+			if (added[i]) continue;
+			if (state[i] == LOWER && g[i] < -tol) { state[i] = FREE; changes++; }
+			else if (state[i] == UPPER && g[i] > tol) { state[i] = FREE; changes++; }
+		}
+		if (changes == 0) { converged = true; break; }
+	}
+	if (bounded) X = X.cwiseMax(0.0).cwiseMin(1.0);
+	if (m_logtype == QPinterface::PRINT_LOG) printf("active set: %d iterations%s\n", iter + 1, converged ? "" : " (not converged)");
+	return converged;
+}
@@ -0,0 +1,57 @@
+// Built-in bounded QP solver (no external library needed)
+
+#ifndef __ActiveSetInterface_H__
+#define __ActiveSetInterface_H__
+
+#include "qp_solver.h"
+
+// Primal active-set method: the equality constraints and the active bounds are fixed, the remaining free
+// variables are found by a sparse Cholesky (LDLT) solve, then the bounds violated by the new iterate are
+// added and the ones whose multiplier has the wrong sign are released, until the active set no longer changes.
+// The constraint rows of A must each select a single variable (this is how BoxGrid pins its handles).
+// Every iteration factorizes the free block anew, which grows quickly with the 3D fill-in: this is the reference
+// solver for small grids, cg and mg scale to high resolutions.
+class ActiveSetInterface : public QPinterface
+{
+public:
+	ActiveSetInterface();
+	virtual ~ActiveSetInterface();
+
+	virtual bool setup(const QPSparseMatrix &Q, const QPSparseMatrix &A, int variableBounds);
+	virtual QPsession * createSession(LOGtype logtype, int numThreads) const;
+
+	void setMaxIterations(int maxIter) { m_maxIter = maxIter; }
+	void setTolerance(double tol) { m_tol = tol; }
+
+private:
+	friend class ActiveSetSession;
+
+	QPSparseMatrix m_Q;
+	vector<int> m_conVar; // variable fixed by each constraint row
+	vector<QPScalarType> m_conCoeff;
+	int m_variableBounds;
+	int m_maxIter;
+	double m_tol;
+	QPScalarType m_reg; // keeps components without any pinned node positive definite
+};
+
+class ActiveSetSession : public QPsession
+{
+public:
+	ActiveSetSession(const ActiveSetInterface &as, QPinterface::LOGtype logtype);
+	virtual ~ActiveSetSession() {}
+
+	// X0 seeds the active set: variables of X0 lying on a bound start out fixed to it.
+	// Returns false if the active set has not settled within the iterations (X is then clamped to the bounds)
+	virtual bool solve(QPVectorX &X, const QPVectorX &b, const QPVectorX *X0 = NULL);
+
+private:
+	enum VarState { FREE, LOWER, UPPER, KNOWN };
+
+	const ActiveSetInterface & m_as;
+	QPinterface::LOGtype m_logtype;
+	QPSparseMatrix m_Qf; // Q restricted to the free variables
+	Eigen::SimplicialLDLT<QPSparseMatrix> m_ldlt;
+};
+
+#endif // __ActiveSetInterface_H__
@@ -0,0 +1,276 @@
+// bbw_bench: times the stages of the BBW pipeline on synthetic meshes and skeletons and writes the results
+// as JSON (one record per mesh, resolution and bone count), so that runs can be compared over time.
+//   bbw_bench [-o results.json] [-resolutions 16,24,32] [-bones 2,4,8] [-meshes cylinder,sphere]
+//             [-solver cg] [-repeat 1] [-handleThreads 1] [-solverThreads 1] [-order scan]
+// Stage times are the fastest of the repetitions, in seconds. The bandwidth is the mean |i - j| over the
+// nonzeros of the Laplacian, i.e. how far apart in memory the neighbours of a node are in the node numbering.
+
+#include "bbw_core.h"
+#include <fstream>
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+
+// capped cylinder along y: radius 1, height 4
+static void makeCylinder(int segments, int rings, PointMatrixType & V, vector<int> & T)
+{
+	V.resize(segments * (rings + 1) + 2, 3);
+	T.clear();
+	for (int j = 0; j <= rings; j++) {
+		for (int i = 0; i < segments; i++) {
+			const double a = 2 * M_PI * i / segments;
+			V.row(j * segments + i) = RowVector3(cos(a), 4.0 * j / rings, sin(a));
+		}
+	}
+	const int bottom = segments * (rings + 1), top = bottom + 1;
+	V.row(bottom) = RowVector3(0, 0, 0);
+	V.row(top) = RowVector3(0, 4, 0);
+	for (int j = 0; j < rings; j++) {
+		for (int i = 0; i < segments; i++) {
+			const int a = j * segments + i, b = j * segments + (i + 1) % segments;
+			const int c = a + segments, d = b + segments;
+			const int quad[6] = { a, c, d, a, d, b };
+			T.insert(T.end(), quad, quad + 6);
+		}
+	}
+	for (int i = 0; i < segments; i++) {
+		const int capB[3] = { bottom, (i + 1) % segments, i };
+		const int capT[3] = { top, rings * segments + i, rings * segments + (i + 1) % segments };
+		T.insert(T.end(), capB, capB + 3);
+		T.insert(T.end(), capT, capT + 3);
+	}
+}
+
+// UV sphere of radius 1 centered on (0, 2, 0), so that the same skeleton fits both meshes
+static void makeSphere(int segments, int rings, PointMatrixType & V, vector<int> & T)
+{
+	V.resize(segments * (rings - 1) + 2, 3);
+	T.clear();
+	for (int j = 1; j < rings; j++) {
+		const double phi = M_PI * j / rings;
+		for (int i = 0; i < segments; i++) {
+			const double a = 2 * M_PI * i / segments;
+			V.row((j - 1) * segments + i) = RowVector3(sin(phi) * cos(a), 2 - cos(phi), sin(phi) * sin(a));
+		}
+	}
+	const int south = segments * (rings - 1), north = south + 1;
+	V.row(south) = RowVector3(0, 1, 0);
+	V.row(north) = RowVector3(0, 3, 0);
+	for (int j = 0; j < rings - 2; j++) {
+		for (int i = 0; i < segments; i++) {
+			const int a = j * segments + i, b = j * segments + (i + 1) % segments;
+			const int c = a + segments, d = b + segments;
+			const int quad[6] = { a, c, d, a, d, b };
+			T.insert(T.end(), quad, quad + 6);
+		}
+	}
+	const int last = (rings - 2) * segments;
+	for (int i = 0; i < segments; i++) {
+		const int capS[3] = { south, (i + 1) % segments, i };
+		const int capN[3] = { north, last + i, last + (i + 1) % segments };
+		T.insert(T.end(), capS, capS + 3);
+		T.insert(T.end(), capN, capN + 3);
+	}
+}
+
+// chain of numBones bones along the y axis of the mesh (the bounding box of both meshes spans y in [ymin, ymax])
+static void makeChain(int numBones, ScalarType ymin, ScalarType ymax, map<string, RowVector3> & B, map<string, string> & boneWise)
+{
+	B.clear();
+	boneWise.clear();
+	const ScalarType margin = 0.05 * (ymax - ymin);
+	for (int i = 0; i <= numBones; i++) {
+		char name[32];
+		sprintf(name, "joint%03d", i);
+		B[name] = RowVector3(0, ymin + margin + (ymax - ymin - 2 * margin) * i / numBones, 0);
+		if (i > 0) {
+			char parent[32];
+			sprintf(parent, "joint%03d", i - 1);
+			boneWise[parent] = name;
+		}
+	}
+}
+
+static bool parseList(const char * arg, vector<int> & values)
+{
+	values.clear();
+	istringstream list(arg);
+	string item;
+	while (getline(list, item, ',')) {
+		const int v = atoi(item.c_str());
+		if (v <= 0) return false;
+		values.push_back(v);
+	}
+	return !values.empty();
+}
+
+struct StageTimes {
+	double voxelize, initVoxels, initStructure, laplacianMEL, product, stencil, solve, interpolate;
+	vector<double> qp;
+	void keepFastest(const StageTimes & t) {
+		voxelize = min(voxelize, t.voxelize);
+		initVoxels = min(initVoxels, t.initVoxels);
+		initStructure = min(initStructure, t.initStructure);
+		laplacianMEL = min(laplacianMEL, t.laplacianMEL);
+		product = min(product, t.product);
+		stencil = min(stencil, t.stencil);
+		interpolate = min(interpolate, t.interpolate);
+		if (t.solve < solve) { solve = t.solve; qp = t.qp; }
+	}
+};
+
+int main(int argc, char ** argv)
+{
+	vector<int> resolutions, bones;
+	parseList("16,24,32", resolutions);
+	parseList("2,4,8", bones);
+	vector<string> meshes;
+	meshes.push_back("cylinder");
+	meshes.push_back("sphere");
+	string output, solverName = "cg", order = "scan";
+	int repeat = 1, handleThreads = 1, solverThreads = 1;
+	for (int i = 1; i < argc; i++) {
+		const string arg = argv[i];
+		const bool hasValue = (i + 1 < argc);
+		bool valid = hasValue;
+		if (arg == "-o" && hasValue) output = argv[++i];
+		else if (arg == "-resolutions" && hasValue) valid = parseList(argv[++i], resolutions);
+		else if (arg == "-bones" && hasValue) valid = parseList(argv[++i], bones);
+		else if (arg == "-meshes" && hasValue) {
+			meshes.clear();
+			istringstream list(argv[++i]);
+			string item;
+			while (getline(list, item, ',')) {
+				if (item != "cylinder" && item != "sphere") valid = false;
+				meshes.push_back(item);
+			}
+		}
+		else if (arg == "-solver" && hasValue) solverName = argv[++i];
+		else if (arg == "-repeat" && hasValue) repeat = max(1, atoi(argv[++i]));
+		else if (arg == "-handleThreads" && hasValue) handleThreads = atoi(argv[++i]);
+		else if (arg == "-solverThreads" && hasValue) solverThreads = atoi(argv[++i]);
+		else if (arg == "-order" && hasValue) {
+			order = argv[++i];
+			valid = (order == "scan" || order == "morton");
+		}
+		else valid = false;
+		if (!valid) {
+			cout << "Error : invalid option " << arg << endl;
+			return 1;
+		}
+	}
+	QPinterface * check = createQPinterface(solverName);
+	if (check == NULL) {
+		cout << "Error : unknown QP solver " << solverName << endl;
+		return 1;
+	}
+	delete check;
+
+	ostringstream json;
+	json.precision(6);
+	json << "{\n  \"solver\": \"" << solverName << "\",\n  \"threads\": " << omp_get_max_threads()
+		<< ",\n  \"handleThreads\": " << handleThreads << ",\n  \"solverThreads\": " << solverThreads
+		<< ",\n  \"repeat\": " << repeat << ",\n  \"order\": \"" << order << "\",\n  \"results\": [";
+	bool first = true;
+	for (unsigned int m = 0; m < meshes.size(); m++) {
+		for (unsigned int r = 0; r < resolutions.size(); r++) {
+			const int res = resolutions[r];
+			// about two mesh vertices per voxel along each side
+			PointMatrixType vertices;
+			vector<int> triangles;
+			if (meshes[m] == "cylinder") makeCylinder(2 * res, 2 * res, vertices, triangles);
+			else makeSphere(2 * res, res, vertices, triangles);
+			RowVector3 bmin, bmax, center;
+			ScalarType scale;
+			const ScalarType ymin = vertices.col(1).minCoeff(), ymax = vertices.col(1).maxCoeff();
+			UnitPacking(vertices, bmin, bmax, scale, center);
+			for (unsigned int k = 0; k < bones.size(); k++) {
+				map<string, RowVector3> B;
+				map<string, string> boneWise;
+				makeChain(bones[k], ymin, ymax, B, boneWise);
+				for (map<string, RowVector3>::iterator it = B.begin(); it != B.end(); ++it) {
+					it->second = scale*(it->second - center) + RowVector3(0.5, 0.5, 0.5);
+				}
+				StageTimes best;
+				int numVoxels = 0, numNodes = 0, numOutside = 0;
+				double bandwidth = 0;
+				for (int rep = 0; rep < repeat; rep++) {
+					StageTimes t;
+					double start = omp_get_wtime();
+					Array3D<bool> voxArray;
+					VoxelizeUnitCube(vertices, triangles, res, voxArray);
+					t.voxelize = omp_get_wtime() - start;
+
+					BoxGrid grid;
+					grid.setMortonOrder(order == "morton");
+					start = omp_get_wtime();
+					grid.initVoxels(res, voxArray);
+					t.initVoxels = omp_get_wtime() - start;
+					start = omp_get_wtime();
+					grid.initStructure();
+					t.initStructure = omp_get_wtime() - start;
+
+					// assembly of the QP matrix: triplets + L*L, and the direct stencil assembly the solve uses
+					const int N = grid.getNumNodes();
+					start = omp_get_wtime();
+					vector<QPSparseMatrixTriplet> L_MEL;
+					grid.laplacianMEL(L_MEL);
+					QPSparseMatrix L(N, N);
+					L.setFromTriplets(L_MEL.begin(), L_MEL.end());
+					t.laplacianMEL = omp_get_wtime() - start;
+					bandwidth = 0;
+					for (int j = 0; j < L.outerSize(); j++)
+						for (QPSparseMatrix::InnerIterator it(L, j); it; ++it) bandwidth += abs(it.row() - j);
+					bandwidth /= L.nonZeros();
+					start = omp_get_wtime();
+					QPSparseMatrix L2 = L*L;
+					t.product = omp_get_wtime() - start;
+					start = omp_get_wtime();
+					grid.laplacian(L);
+					BoxGrid::bilaplacian(L, L2);
+					t.stencil = omp_get_wtime() - start;
+
+					grid.setSolverThreads(handleThreads, solverThreads);
+					grid.setSolver(solverName);
+					start = omp_get_wtime();
+					grid.computeBoneBBW(B, boneWise);
+					t.solve = omp_get_wtime() - start;
+					t.qp = grid.getHandleSolveTimes();
+
+					RowMatrixXX weights;
+					start = omp_get_wtime();
+					numOutside = grid.getInterpolatedBBW(vertices, weights, B.size());
+					t.interpolate = omp_get_wtime() - start;
+
+					numVoxels = grid.getNumBoxes();
+					numNodes = N;
+					if (rep == 0) best = t;
+					else best.keepFastest(t);
+				}
+				json << (first ? "" : ",") << "\n    {\"mesh\": \"" << meshes[m] << "\", \"resolution\": " << res
+					<< ", \"bones\": " << bones[k] << ", \"vertices\": " << vertices.rows() << ", \"triangles\": " << triangles.size() / 3
+					<< ", \"voxels\": " << numVoxels << ", \"nodes\": " << numNodes << ", \"outside\": " << numOutside
+					<< ", \"bandwidth\": " << bandwidth
+					<< ",\n     \"voxelize\": " << best.voxelize << ", \"initVoxels\": " << best.initVoxels
+					<< ", \"initStructure\": " << best.initStructure << ", \"laplacianMEL\": " << best.laplacianMEL
+					<< ", \"product\": " << best.product << ", \"stencilAssembly\": " << best.stencil
+					<< ",\n     \"solve\": " << best.solve << ", \"qp\": [";
+				for (unsigned int j = 0; j < best.qp.size(); j++) json << (j == 0 ? "" : ", ") << best.qp[j];
+				json << "], \"interpolate\": " << best.interpolate << "}";
+				first = false;
+				cerr << "bbw_bench: " << meshes[m] << " " << res << "^3, " << bones[k] << " bones: " << numNodes << " nodes, solve " << best.solve << "s" << endl;
+			}
+		}
+	}
+	json << "\n  ]\n}\n";
+	if (output.empty()) cout << json.str();
+	else {
+		ofstream file(output.c_str());
+		file << json.str();
+		if (!file) {
+			cout << "Error : cannot write " << output << endl;
+			return 1;
+		}
+	}
+	return 0;
+}
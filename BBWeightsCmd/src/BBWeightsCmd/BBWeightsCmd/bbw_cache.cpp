@@ -0,0 +1,98 @@
+#include "bbw_cache.h"
+#include <string.h>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+uint64_t hashFNV1a(const void * data, size_t size, uint64_t h)
+{
+	const unsigned char * bytes = (const unsigned char *)data;
+	for (size_t i = 0; i < size; ++i) {
+		h ^= bytes[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+BBWCache::BBWCache() : m_data(NULL), m_size(0)
+{
+#ifdef _WIN32
+	m_file = m_mapping = NULL;
+#else
+	m_file = -1;
+#endif
+}
+
+BBWCache::~BBWCache()
+{
+	close();
+}
+
+bool BBWCache::open(const string & filename, uint64_t key)
+{
+	close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER size;
+	GetFileSizeEx(file, &size);
+	m_file = file;
+	m_size = (size_t)size.QuadPart;
+	if (m_size < sizeof(BBWCacheHeader)) { close(); return false; }
+	m_mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_mapping == NULL) { close(); return false; }
+	m_data = (const char *)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (m_data == NULL) { close(); return false; }
+#else
+	m_file = ::open(filename.c_str(), O_RDONLY);
+	if (m_file == -1) return false;
+	struct stat st;
+	if (fstat(m_file, &st) != 0 || (size_t)st.st_size < sizeof(BBWCacheHeader)) { close(); return false; }
+	m_size = st.st_size;
+	void * data = mmap(NULL, m_size, PROT_READ, MAP_SHARED, m_file, 0);
+	if (data == MAP_FAILED) { close(); return false; }
+	m_data = (const char *)data;
+#endif
+	const BBWCacheHeader & h = header();
+	// counts checked for sign and the sections for size without overflow, before anything is read through them
+	const bool valid = memcmp(h.magic, "BBWC", 4) == 0 && h.version == BBW_CACHE_VERSION && h.key == key
+		&& h.scalarSize == sizeof(ScalarType) && h.nodeWeightSize == sizeof(WeightMatrix::StorageType)
+		&& h.fileSize == m_size
+		&& h.numNodes >= 0 && h.numHandles >= 0 && h.numVertices >= 0 && h.numBones >= 0
+		&& h.nodeWeightsOffset <= m_size && h.vertexWeightsOffset <= m_size
+		&& (uint64_t)h.numNodes * h.numHandles <= (m_size - h.nodeWeightsOffset) / h.nodeWeightSize
+		&& (uint64_t)h.numVertices * h.numBones <= (m_size - h.vertexWeightsOffset) / h.scalarSize;
+	if (!valid) close();
+	return valid;
+}
+
+bool replaceFile(const string & from, const string & to)
+{
+#ifdef _WIN32
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+void BBWCache::close()
+{
+#ifdef _WIN32
+	if (m_data != NULL) UnmapViewOfFile(m_data);
+	if (m_mapping != NULL) CloseHandle(m_mapping);
+	if (m_file != NULL) CloseHandle(m_file);
+	m_file = m_mapping = NULL;
+#else
+	if (m_data != NULL) munmap((void *)m_data, m_size);
+	if (m_file != -1) ::close(m_file);
+	m_file = -1;
+#endif
+	m_data = NULL;
+	m_size = 0;
+}
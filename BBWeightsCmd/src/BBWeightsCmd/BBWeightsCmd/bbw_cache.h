@@ -0,0 +1,64 @@
+// Binary cache of computed weights, so that reopening a rig doesn't solve the QPs again.
+// Layout (little endian, sections aligned on 64 bytes):
+//   BBWCacheHeader
+//   node weights:   numNodes x numHandles WeightMatrix::StorageType, row-major
+//   vertex weights: numVertices x numBones ScalarType, row-major
+// The file is memory mapped when read, the weights are used in place.
+
+#ifndef __BBWCACHE_H__
+#define __BBWCACHE_H__
+
+#include "STL_inc.h"
+#include "EIGEN_inc.h"
+#include "Weights.h"
+#include <stdint.h>
+
+#define BBW_CACHE_VERSION 1
+
+struct BBWCacheHeader
+{
+	char magic[4]; // "BBWC"
+	uint32_t version;
+	uint64_t key; // hash of the inputs (mesh, joints, resolution, options)
+	uint32_t scalarSize; // sizeof(ScalarType) of the vertex weights
+	uint32_t nodeWeightSize; // sizeof(WeightMatrix::StorageType) of the node weights
+	int32_t gridSize[3]; // boxes in x, y, z
+	int32_t numNodes, numHandles;
+	int32_t numVertices, numBones;
+	double lowerLeft[3], upperRight[3];
+	uint64_t nodeWeightsOffset, vertexWeightsOffset, fileSize;
+};
+
+// FNV-1a, chained through h
+uint64_t hashFNV1a(const void * data, size_t size, uint64_t h = 14695981039346656037ULL);
+
+// moves from onto to, replacing it in one step (a reader sees either file, never none)
+bool replaceFile(const string & from, const string & to);
+
+// read-only memory mapping of a cache file, valid for a given key
+class BBWCache
+{
+public:
+	BBWCache();
+	~BBWCache();
+
+	// false if the file is missing, truncated, of another version/precision, or computed for another key
+	bool open(const string & filename, uint64_t key);
+	void close();
+	bool isOpen() const { return m_data != NULL; }
+
+	const BBWCacheHeader & header() const { return *(const BBWCacheHeader *)m_data; }
+	const WeightMatrix::StorageType * nodeWeights() const { return (const WeightMatrix::StorageType *)(m_data + header().nodeWeightsOffset); }
+	const ScalarType * vertexWeights() const { return (const ScalarType *)(m_data + header().vertexWeightsOffset); }
+
+private:
+	const char * m_data;
+	size_t m_size;
+#ifdef _WIN32
+	void * m_file, * m_mapping;
+#else
+	int m_file;
+#endif
+};
+
+#endif // __BBWCACHE_H__
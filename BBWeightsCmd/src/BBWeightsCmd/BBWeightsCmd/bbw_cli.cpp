@@ -0,0 +1,182 @@
+// bbw: headless bounded biharmonic weights, the bbwSolver pipeline without Maya.
+//   bbw <mesh.obj> <skeleton.txt> <weights.txt> [options]
+// The weights file lists the bones (in column order) on its first line, then one line per vertex:
+// the number of influences followed by (bone index, weight) pairs.
+
+#include "bbw_core.h"
+#include "OctreeGrid.h"
+#include <fstream>
+#include <stdlib.h>
+#include <omp.h>
+
+static void usage()
+{
+	cout << "usage: bbw <mesh.obj> <skeleton.txt> <weights.txt> [options]" << endl
+		<< "  -voxResolution <n>     voxels per side (64)" << endl
+		<< "  -solver <name>         QP backend (" << defaultQPinterface() << ")" << endl
+		<< "  -handleThreads <n>     handles solved in parallel, 0: as many as the cores allow (1)" << endl
+		<< "  -solverThreads <n>     threads of each QP solve (4)" << endl
+		<< "  -adaptive <levels>     octree grid instead of the uniform one (0)" << endl
+		<< "  -cascade <levels>      coarser grids solved first to warm start the solve (0)" << endl
+		<< "  -order <scan|morton>   numbering of the grid nodes (scan)" << endl
+		<< "  -maxInfluences <k>     largest weights kept per vertex, 0: all (0)" << endl
+		<< "  -pruneWeight <eps>     weights below are dropped (0)" << endl
+		<< "  -profile <file>        per-stage timings and memory as JSON" << endl;
+}
+
+static bool writeWeights(const string & filename, const map<string, RowVector3> & B, const SparseWeights & weights)
+{
+	ofstream file(filename.c_str());
+	if (!file) {
+		cout << "Error : cannot write " << filename << endl;
+		return false;
+	}
+	file.precision(9);
+	for (map<string, RowVector3>::const_iterator it = B.begin(); it != B.end(); ++it) {
+		file << (it == B.begin() ? "" : " ") << it->first;
+	}
+	file << "\n";
+	for (int v = 0; v < weights.getNumVertices(); v++) {
+		file << weights.getNumInfluences(v);
+		for (int k = weights.offsets[v]; k < weights.offsets[v + 1]; k++) file << " " << weights.influences[k] << " " << weights.weights[k];
+		file << "\n";
+	}
+	return (bool)file;
+}
+
+int main(int argc, char ** argv)
+{
+	int res = 64;
+	string solverName = defaultQPinterface();
+	int handleThreads = 1, solverThreads = 4;
+	int adaptiveLevels = 0;
+	int cascadeLevels = 0;
+	string order = "scan";
+	int maxInfluences = 0;
+	double pruneWeight = 0;
+	string profileFile;
+	vector<string> files;
+	for (int i = 1; i < argc; i++) {
+		const string arg = argv[i];
+		const bool hasValue = (i + 1 < argc);
+		if (arg == "-voxResolution" && hasValue) res = atoi(argv[++i]);
+		else if (arg == "-solver" && hasValue) solverName = argv[++i];
+		else if (arg == "-handleThreads" && hasValue) handleThreads = atoi(argv[++i]);
+		else if (arg == "-solverThreads" && hasValue) solverThreads = atoi(argv[++i]);
+		else if (arg == "-adaptive" && hasValue) adaptiveLevels = atoi(argv[++i]);
+		else if (arg == "-cascade" && hasValue) cascadeLevels = atoi(argv[++i]);
+		else if (arg == "-order" && hasValue) order = argv[++i];
+		else if (arg == "-maxInfluences" && hasValue) maxInfluences = atoi(argv[++i]);
+		else if (arg == "-pruneWeight" && hasValue) pruneWeight = atof(argv[++i]);
+		else if (arg == "-profile" && hasValue) profileFile = argv[++i];
+		else if (arg[0] == '-') {
+			cout << "Error : unknown option " << arg << endl;
+			usage();
+			return 1;
+		}
+		else files.push_back(arg);
+	}
+	if (order != "scan" && order != "morton") {
+		cout << "Error : unknown order " << order << endl;
+		usage();
+		return 1;
+	}
+	if (files.size() != 3 || res < 1) {
+		usage();
+		return 1;
+	}
+	QPinterface * check = createQPinterface(solverName);
+	if (check == NULL) {
+		cout << "Error : unknown QP solver " << solverName << endl;
+		return 1;
+	}
+	delete check;
+	bool mortonOrder = (order == "morton");
+	vector<string> warnings;
+	CheckGridOptions(adaptiveLevels, solverName, cascadeLevels, mortonOrder, warnings);
+	for (size_t i = 0; i < warnings.size(); i++) cout << "Warning : " << warnings[i] << endl;
+	const double start = omp_get_wtime();
+	BBWProfile profile;
+	BBWProfile * prof = profileFile.empty() ? NULL : &profile;
+
+	PointMatrixType vertices;
+	vector<int> triangles;
+	map<string, RowVector3> B;
+	map<string, string> boneWise;
+	{
+		BBWProfile::Scope scope(prof, "read");
+		if (!ReadOBJ(files[0], vertices, triangles) || !ReadSkeleton(files[1], B, boneWise)) return 1;
+	}
+	cout << "BBW: " << vertices.rows() << " vertices, " << triangles.size() / 3 << " triangles, " << B.size() << " joints" << endl;
+
+	/*pack the mesh and the joints in the unit cube*/
+	RowVector3 bmin, bmax, center;
+	ScalarType scale;
+	UnitPacking(vertices, bmin, bmax, scale, center);
+	for (map<string, RowVector3>::iterator it = B.begin(); it != B.end(); ++it) {
+		it->second = scale*(it->second - center) + RowVector3(0.5, 0.5, 0.5);
+	}
+
+	/*grid*/
+	Array3D<bool> voxArray;
+	{
+		BBWProfile::Scope scope(prof, "voxelization");
+		if (!VoxelizeUnitCube(vertices, triangles, res, voxArray)) {
+			cout << "Error : voxelization failed" << endl;
+			return 1;
+		}
+	}
+	vector<RowVector3> refinementPoints;
+	if (adaptiveLevels > 0) BoneRefinementPoints(B, boneWise, refinementPoints);
+	BoxGrid * grid = CreateGrid(res, voxArray, adaptiveLevels, refinementPoints);
+	grid->setMortonOrder(mortonOrder);
+	{
+		BBWProfile::Scope scope(prof, "gridBuild");
+		grid->initStructure();
+	}
+	cout << "BBW: " << voxArray.count() << " voxels, " << grid->getNumNodes() << " nodes" << endl;
+
+	/*solve*/
+	grid->setSolverThreads(handleThreads, solverThreads);
+	grid->setSolver(solverName);
+	grid->setCascade(cascadeLevels);
+	grid->setProfile(prof);
+	bool solved;
+	{
+		BBWProfile::Scope scope(prof, "solve");
+		solved = grid->computeBoneBBW(B, boneWise);
+	}
+	RowMatrixXX weights;
+	int outside = 0;
+	if (solved) {
+		BBWProfile::Scope scope(prof, "interpolation");
+		outside = grid->getInterpolatedBBW(vertices, weights, B.size());
+	}
+	delete grid;
+	// no weights file from a failed solve, the exit status tells the caller
+	if (!solved || outside > 0) {
+		cout << "Error : no weights written" << endl;
+		return 1;
+	}
+
+	SparseWeights sparseWeights;
+	{
+		BBWProfile::Scope scope(prof, "influences");
+		const int emptyRows = sparseWeights.build(weights, maxInfluences, pruneWeight);
+		if (emptyRows > 0) cout << "Warning : " << emptyRows << " vertices have no positive weight and are written without influence" << endl;
+	}
+	{
+		BBWProfile::Scope scope(prof, "write");
+		if (!writeWeights(files[2], B, sparseWeights)) return 1;
+	}
+	printf("BBW: weights written to %s in %fs\n", files[2].c_str(), omp_get_wtime() - start);
+	if (prof != NULL) {
+		ofstream file(profileFile.c_str());
+		file << profile.toJSON() << "\n";
+		if (!file) {
+			cout << "Error : cannot write " << profileFile << endl;
+			return 1;
+		}
+	}
+	return 0;
+}
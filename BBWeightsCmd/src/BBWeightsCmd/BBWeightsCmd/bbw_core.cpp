@@ -0,0 +1,162 @@
+#include "bbw_core.h"
+#include "OctreeGrid.h"
+#include "Voxelizer.h"
+#include <fstream>
+
+void UnitPacking(PointMatrixType & vertices, RowVector3 & bmin, RowVector3 & bmax, ScalarType & scale, RowVector3 & center)
+{
+	const int nbV = vertices.rows();
+	bmin = bmax = vertices.row(0);
+	for (int i = 1; i < nbV; i++) {
+		bmin = bmin.cwiseMin(vertices.row(i));
+		bmax = bmax.cwiseMax(vertices.row(i));
+	}
+	RowVector3 length = (bmax - bmin).cwiseInverse();
+	scale = 0.95*length.minCoeff();
+	center = (bmin + bmax) / 2.0;
+	for (int i = 0; i < nbV; i++) {
+		vertices.row(i) = scale*(vertices.row(i) - center) + RowVector3(0.5, 0.5, 0.5);
+	}
+}
+
+bool VoxelizeUnitCube(const PointMatrixType & vertices, const vector<int> & triangles, int res, Array3D<bool> & voxArray)
+{
+	vector<float> points(3 * vertices.rows());
+	for (int i = 0; i < vertices.rows(); i++) {
+		for (int k = 0; k < 3; k++) points[3 * i + k] = (float)vertices(i, k);
+	}
+	const float bmin[3] = { 0, 0, 0 };
+	const float bmax[3] = { 1, 1, 1 };
+	voxArray.init(res, res, res);
+	if (!VoxelizeSolid(points, triangles, bmin, bmax, res, res, res, voxArray)) return false;
+	// the surface lies on the voxel boundaries, its vertices may fall in a voxel left empty by the parity test.
+	// Same rounding as BoxGrid::getBoxContainingPoint.
+	const ScalarType frac = 1.0 / res;
+	for (int i = 0; i < vertices.rows(); i++) {
+		const int x = min(res - 1, max(0, (int)floor(vertices(i, 0) / frac)));
+		const int y = min(res - 1, max(0, (int)floor(vertices(i, 1) / frac)));
+		const int z = min(res - 1, max(0, (int)floor(vertices(i, 2) / frac)));
+		voxArray.set(x, y, z, true);
+	}
+	return true;
+}
+
+void BoneRefinementPoints(const map<string, RowVector3> & B, const map<string, string> & boneWise, vector<RowVector3> & points)
+{
+	points.clear();
+	for (map<string, RowVector3>::const_iterator it = B.begin(); it != B.end(); ++it) points.push_back(it->second);
+	for (map<string, string>::const_iterator it = boneWise.begin(); it != boneWise.end(); ++it) {
+		points.push_back(0.5 * (B.at(it->first) + B.at(it->second)));
+	}
+}
+
+BoxGrid * CreateGrid(int res, const Array3D<bool> & voxArray, int adaptiveLevels, const vector<RowVector3> & refinementPoints)
+{
+	BoxGrid * grid;
+	if (adaptiveLevels > 0) {
+		OctreeGrid * octree = new OctreeGrid(adaptiveLevels);
+		octree->setRefinementPoints(refinementPoints);
+		grid = octree;
+	}
+	else grid = new BoxGrid();
+	grid->initVoxels(res, voxArray);
+	return grid;
+}
+
+void CheckGridOptions(int adaptiveLevels, const string & solverName, int & cascadeLevels, bool & mortonOrder, vector<string> & warnings)
+{
+	warnings.clear();
+	if (adaptiveLevels <= 0) return;
+	if (solverName == "mg") warnings.push_back("the octree grid has no multigrid hierarchy, the mg solver falls back to Jacobi preconditioning (use the uniform grid)");
+	if (cascadeLevels > 0) warnings.push_back("the cascade is not supported on the octree grid, ignored");
+	if (mortonOrder) warnings.push_back("the Morton order is not supported on the octree grid, ignored");
+	cascadeLevels = 0;
+	mortonOrder = false;
+}
+
+bool ReadOBJ(const string & filename, PointMatrixType & vertices, vector<int> & triangles)
+{
+	ifstream file(filename.c_str());
+	if (!file) {
+		cout << "Error : cannot open " << filename << endl;
+		return false;
+	}
+	vector<RowVector3> points;
+	triangles.clear();
+	string line;
+	vector<int> polygon;
+	while (getline(file, line)) {
+		istringstream record(line);
+		string type;
+		record >> type;
+		if (type == "v") {
+			RowVector3 p;
+			record >> p[0] >> p[1] >> p[2];
+			points.push_back(p);
+		}
+		else if (type == "f") {
+			// "i", "i/t", "i//n" or "i/t/n", 1-based, negative relative to the end
+			polygon.clear();
+			string corner;
+			while (record >> corner) {
+				int id = atoi(corner.c_str());
+				id = (id < 0) ? (int)points.size() + id : id - 1;
+				if (id < 0 || id >= (int)points.size()) {
+					cout << "Error : invalid vertex index in " << filename << ": " << line << endl;
+					return false;
+				}
+				polygon.push_back(id);
+			}
+			for (int i = 2; i < (int)polygon.size(); i++) {
+				triangles.push_back(polygon[0]);
+				triangles.push_back(polygon[i - 1]);
+				triangles.push_back(polygon[i]);
+			}
+		}
+	}
+	if (points.empty() || triangles.empty()) {
+		cout << "Error : no mesh in " << filename << endl;
+		return false;
+	}
+	vertices.resize(points.size(), 3);
+	for (int i = 0; i < (int)points.size(); i++) vertices.row(i) = points[i];
+	return true;
+}
+
+bool ReadSkeleton(const string & filename, map<string, RowVector3> & B, map<string, string> & boneWise)
+{
+	ifstream file(filename.c_str());
+	if (!file) {
+		cout << "Error : cannot open " << filename << endl;
+		return false;
+	}
+	B.clear();
+	boneWise.clear();
+	vector<pair<string, string> > parents;
+	string line;
+	while (getline(file, line)) {
+		line = line.substr(0, line.find('#'));
+		istringstream record(line);
+		string name, parent;
+		RowVector3 p;
+		if (!(record >> name)) continue;
+		if (!(record >> p[0] >> p[1] >> p[2])) {
+			cout << "Error : invalid joint in " << filename << ": " << line << endl;
+			return false;
+		}
+		B[name] = p;
+		if (record >> parent) parents.push_back(make_pair(parent, name));
+	}
+	for (unsigned int i = 0; i < parents.size(); i++) {
+		if (B.find(parents[i].first) == B.end()) {
+			cout << "Error : unknown parent joint " << parents[i].first << " in " << filename << endl;
+			return false;
+		}
+		boneWise[parents[i].first] = parents[i].second;
+	}
+	if (B.empty()) {
+		cout << "Error : no joint in " << filename << endl;
+		return false;
+	}
+	return true;
+}
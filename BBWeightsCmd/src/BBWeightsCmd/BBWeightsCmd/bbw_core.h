@@ -0,0 +1,39 @@
+// Maya-free BBW pipeline: unit packing, voxelization, grid construction and skeleton input,
+// shared by the bbwSolver command and the bbw command line tool. bbwSolver only differs with -voxelizer gl,
+// whose voxels span the mesh bounding box instead of the unit cube.
+
+#ifndef __BBWCORE_H__
+#define __BBWCORE_H__
+
+#include "STL_inc.h"
+#include "EIGEN_inc.h"
+#include "Array3D.h"
+#include "BoxGrid.h"
+
+// maps the vertices (in place) into the unit cube the grid is defined on: centered on 0.5,
+// the largest side of the bounding box scaled to 0.95
+void UnitPacking(PointMatrixType & vertices, RowVector3 & bmin, RowVector3 & bmax, ScalarType & scale, RowVector3 & center);
+
+// solid voxelization of packed vertices over the unit cube, res^3 voxels. The voxels containing a vertex are
+// added, so that every vertex can be interpolated from the grid.
+bool VoxelizeUnitCube(const PointMatrixType & vertices, const vector<int> & triangles, int res, Array3D<bool> & voxArray);
+
+// the points kept at the finest octree level: the joints and the middle of the bones
+void BoneRefinementPoints(const map<string, RowVector3> & B, const map<string, string> & boneWise, vector<RowVector3> & points);
+
+// uniform grid, or octree with adaptiveLevels > 0, over the voxels; initStructure is left to the caller
+BoxGrid * CreateGrid(int res, const Array3D<bool> & voxArray, int adaptiveLevels, const vector<RowVector3> & refinementPoints);
+
+// the octree (adaptiveLevels > 0) has no coarser grids and no Morton numbering: cascadeLevels and mortonOrder are
+// cleared, and warnings gets a message for each option it does not support (including the mg solver, which
+// then runs with the Jacobi preconditioner of cg)
+void CheckGridOptions(int adaptiveLevels, const string & solverName, int & cascadeLevels, bool & mortonOrder, vector<string> & warnings);
+
+// reads a mesh from an OBJ file (v and f records, polygons are fanned into triangles)
+bool ReadOBJ(const string & filename, PointMatrixType & vertices, vector<int> & triangles);
+
+// reads a skeleton, one joint per line: "name x y z [parent]", '#' starts a comment. Positions are in the
+// space of the mesh. As for the Maya hierarchy, each joint drives the bone to its (last) child.
+bool ReadSkeleton(const string & filename, map<string, RowVector3> & B, map<string, string> & boneWise);
+
+#endif // __BBWCORE_H__
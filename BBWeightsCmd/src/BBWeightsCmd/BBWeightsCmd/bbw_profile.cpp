@@ -0,0 +1,59 @@
+#include "bbw_profile.h"
+#include <omp.h>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+BBWProfile::Scope::Scope(BBWProfile * profile, const char * name) : m_profile(profile), m_stage(-1), m_start(0)
+{
+	if (m_profile == NULL) return;
+	Stage stage = { name, m_profile->m_depth++, 0, 0 };
+	m_stage = m_profile->m_stages.size();
+	m_profile->m_stages.push_back(stage);
+	m_start = omp_get_wtime();
+}
+
+BBWProfile::Scope::~Scope()
+{
+	if (m_profile == NULL) return;
+	Stage & stage = m_profile->m_stages[m_stage];
+	stage.seconds = omp_get_wtime() - m_start;
+	stage.peakRSS = peakRSS();
+	m_profile->m_depth--;
+}
+
+size_t BBWProfile::peakRSS()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+	return usage.ru_maxrss; // bytes
+#else
+	return (size_t)usage.ru_maxrss * 1024; // kilobytes
+#endif
+#endif
+}
+
+string BBWProfile::toJSON() const
+{
+	ostringstream json;
+	json.precision(6);
+	json << "{\"stages\": [";
+	for (unsigned int i = 0; i < m_stages.size(); i++) {
+		json << (i == 0 ? "" : ", ") << "{\"name\": \"" << m_stages[i].name << "\", \"depth\": " << m_stages[i].depth << ", \"seconds\": " << m_stages[i].seconds
+			<< ", \"peakRSS\": " << m_stages[i].peakRSS << "}";
+	}
+	json << "], \"qp\": [";
+	for (unsigned int j = 0; j < m_handleTimes.size(); j++) json << (j == 0 ? "" : ", ") << m_handleTimes[j];
+	json << "], \"peakRSS\": " << peakRSS() << "}";
+	return json.str();
+}
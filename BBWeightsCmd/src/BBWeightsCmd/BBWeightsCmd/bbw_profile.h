@@ -0,0 +1,48 @@
+// Per-stage timings and memory of a BBW run, reported as JSON (bbwSolver -profile, bbw -profile).
+
+#ifndef __BBWPROFILE_H__
+#define __BBWPROFILE_H__
+
+#include "STL_inc.h"
+
+class BBWProfile
+{
+public:
+	// times the enclosing scope as a stage of profile (nothing if profile is NULL). Stages may nest,
+	// they are listed in the order they start.
+	class Scope
+	{
+	public:
+		Scope(BBWProfile * profile, const char * name);
+		~Scope();
+	private:
+		BBWProfile * m_profile;
+		int m_stage;
+		double m_start;
+	};
+
+	BBWProfile() : m_depth(0) {}
+
+	void clear() { m_stages.clear(); m_handleTimes.clear(); m_depth = 0; }
+	// seconds of the QP of each handle
+	void setHandleTimes(const vector<double> & times) { m_handleTimes = times; }
+	// {"stages": [{"name", "depth", "seconds", "peakRSS"}...], "qp": [...], "peakRSS"}, peakRSS in bytes,
+	// depth > 0 for the stages nested in another one
+	string toJSON() const;
+
+	// peak resident memory of the process in bytes (0 if unknown)
+	static size_t peakRSS();
+
+private:
+	struct Stage {
+		string name;
+		int depth;
+		double seconds;
+		size_t peakRSS; // at the end of the stage
+	};
+	vector<Stage> m_stages;
+	vector<double> m_handleTimes;
+	int m_depth;
+};
+
+#endif // __BBWPROFILE_H__
@@ -0,0 +1,146 @@
+#include "cg_solver.h"
+
+CGInterface::CGInterface() : m_matrixOperator(m_Q), m_op(NULL)
+{
+	m_variableBounds = 1;
+	m_maxIter = 100;
+	m_maxCGIter = 20000;
+	m_tol = 1e-8;
+	m_cgTol = 1e-10;
+	m_searchTol = 1e-2;
+}
+
+CGInterface::~CGInterface()
+{
+}
+
+bool CGInterface::setup(const QPSparseMatrix &Q, const QPSparseMatrix &A, int variableBounds)
+{
+	m_Q = Q;
+	return setupOperator(m_matrixOperator, A, variableBounds);
+}
+
+bool CGInterface::setupOperator(const QPoperator &Q, const QPSparseMatrix &A, int variableBounds)
+{
+	assert(Q.size() == A.cols());
+	m_op = &Q;
+	m_variableBounds = variableBounds;
+
+	m_conVar.assign(A.rows(), -1);
+	m_conCoeff.assign(A.rows(), 0);
+	for (int k = 0; k < A.outerSize(); ++k) {
+		for (QPSparseMatrix::InnerIterator it(A, k); it; ++it) {
+			if (it.value() == 0) continue;
+			if (m_conVar[it.row()] != -1) {
+				cout << "Error : cg solver only supports constraints on a single variable" << endl;
+				return false;
+			}
+			m_conVar[it.row()] = it.col();
+			m_conCoeff[it.row()] = it.value();
+		}
+	}
+
+	Q.diagonal(m_invDiag);
+	for (int i = 0; i < m_invDiag.rows(); ++i) m_invDiag[i] = (m_invDiag[i] > 0) ? 1.0 / m_invDiag[i] : 1.0;
+	return true;
+}
+
+QPsession * CGInterface::createSession(LOGtype logtype, int /*numThreads*/) const
+{
+	return new CGSession(*this, logtype);
+}
+
+void CGSession::precondition(const QPVectorX &r, QPVectorX &z, const vector<char> & /*state*/)
+{
+	z = m_cg.m_invDiag.cwiseProduct(r);
+}
+
+int CGSession::solveFree(QPVectorX &X, const vector<char> &state, double cgTol, bool &reached)
+{
+	const int N = X.rows();
+	// residual of Q_FF x_F = -Q_FC x_C at the current X, restricted to the free variables
+	m_cg.m_op->apply(X, m_r);
+	m_r = -m_r;
+	for (int i = 0; i < N; ++i) if (state[i] != FREE) m_r[i] = 0;
+	precondition(m_r, m_z, state);
+	m_p = m_z;
+	QPScalarType rz = m_r.dot(m_z);
+	const QPScalarType stop = cgTol * cgTol * max((QPScalarType)m_r.squaredNorm(), (QPScalarType)1e-30);
+	int k = 0;
+	for (; k < m_cg.m_maxCGIter && m_r.squaredNorm() > stop; ++k) {
+		m_cg.m_op->apply(m_p, m_q);
+		for (int i = 0; i < N; ++i) if (state[i] != FREE) m_q[i] = 0;
+		const QPScalarType pq = m_p.dot(m_q);
+		if (pq <= 0) break; // direction of zero curvature: nothing left to minimize
+		const QPScalarType alpha = rz / pq;
+		X += alpha * m_p;
+		m_r -= alpha * m_q;
+		precondition(m_r, m_z, state);
+		const QPScalarType rzNew = m_r.dot(m_z);
+		m_p = m_z + (rzNew / rz) * m_p;
+		rz = rzNew;
+	}
+	reached = (m_r.squaredNorm() <= stop);
+	return k;
+}
+
+bool CGSession::solve(QPVectorX &X, const QPVectorX &b, const QPVectorX *X0)
+{
+	if (m_cg.m_op == NULL) return false;
+	const int N = m_cg.m_op->size();
+	const bool bounded = (m_cg.m_variableBounds == 1);
+	const QPScalarType tol = m_cg.m_tol;
+	assert(b.rows() == (int)m_cg.m_conVar.size());
+
+	vector<char> state(N, FREE);
+	X.setZero(N);
+	if (X0 != NULL && X0->rows() == N) {
+		X = *X0;
+		if (bounded) {
+			for (int i = 0; i < N; ++i) {
+				if ((*X0)[i] <= tol) { state[i] = LOWER; X[i] = 0; }
+				else if ((*X0)[i] >= 1.0 - tol) { state[i] = UPPER; X[i] = 1.0; }
+			}
+		}
+	}
+	for (unsigned int r = 0; r < m_cg.m_conVar.size(); ++r) {
+		const int v = m_cg.m_conVar[r];
+		if (v == -1) continue;
+		state[v] = KNOWN;
+		X[v] = b[r] / m_cg.m_conCoeff[r];
+	}
+
+	QPVectorX g(N);
+	// the active set is searched with loose CG solves, the final one is solved to cgTol
+	double cgTol = bounded ? max(m_cg.m_cgTol, m_cg.m_searchTol) : m_cg.m_cgTol;
+	int iter = 0, cgIter = 0;
+	bool converged = false, reached = false;
+	for (; iter < m_cg.m_maxIter; ++iter) {
+		// equality-constrained subproblem on the free variables
+		cgIter += solveFree(X, state, cgTol, reached);
+		if (!bounded) { converged = reached; break; }
+
+		// add the violated bounds
+		int changes = 0;
+		vector<char> added(N, 0);
+		for (int i = 0; i < N; ++i) {
+			if (state[i] != FREE) continue;
+			if (X[i] < -tol) { state[i] = LOWER; X[i] = 0; added[i] = 1; changes++; }
+			else if (X[i] > 1.0 + tol) { state[i] = UPPER; X[i] = 1.0; added[i] = 1; changes++; }
+		}
+		// release the bounds whose multiplier (the gradient 2Qx) pushes the variable back inside
+		m_cg.m_op->apply(X, g);
+		for (int i = 0; i < N; ++i) {
+			if (added[i]) continue;
+			if (state[i] == LOWER && g[i] < -tol) { state[i] = FREE; changes++; }
+			else if (state[i] == UPPER && g[i] > tol) { state[i] = FREE; changes++; }
+		}
+		if (changes == 0) {
+			if (cgTol <= m_cg.m_cgTol) { converged = reached; break; }
+			cgTol = m_cg.m_cgTol;
+		}
+	}
+	if (bounded) X = X.cwiseMax(0.0).cwiseMin(1.0);
+	if (m_logtype == QPinterface::PRINT_LOG) printf("cg: %d active set iterations, %d cg iterations%s\n", iter + 1, cgIter, converged ? "" : " (not converged)");
+	return converged;
+}
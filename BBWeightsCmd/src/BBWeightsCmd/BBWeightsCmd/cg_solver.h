@@ -0,0 +1,65 @@
+// Built-in matrix-free bounded QP solver
+
+#ifndef __CGInterface_H__
+#define __CGInterface_H__
+
+#include "qp_solver.h"
+
+// Same primal active-set iteration as ActiveSetInterface, but the subproblem on the free variables is solved
+// by Jacobi-preconditioned conjugate gradients, so Q is only accessed through products Qx. Set up from an
+// operator (e.g. the grid stencil of BoxGrid) it never stores Q; set up from a matrix it keeps a copy.
+// The constraint rows of A must each select a single variable.
+class CGInterface : public QPinterface
+{
+public:
+	CGInterface();
+	virtual ~CGInterface();
+
+	virtual bool setup(const QPSparseMatrix &Q, const QPSparseMatrix &A, int variableBounds);
+	virtual bool isMatrixFree() const { return true; }
+	virtual bool setupOperator(const QPoperator &Q, const QPSparseMatrix &A, int variableBounds);
+	virtual QPsession * createSession(LOGtype logtype, int numThreads) const;
+
+	void setMaxIterations(int maxIter, int maxCGIter) { m_maxIter = maxIter; m_maxCGIter = maxCGIter; }
+	// cgTol: relative residual of the last CG solve, searchTol: of the solves while the active set changes
+	void setTolerance(double tol, double cgTol, double searchTol = 1e-2) { m_tol = tol; m_cgTol = cgTol; m_searchTol = searchTol; }
+
+protected:
+	friend class CGSession;
+
+	QPSparseMatrix m_Q; // only when set up from a matrix
+	SparseQPoperator m_matrixOperator;
+	const QPoperator * m_op;
+	QPVectorX m_invDiag; // Jacobi preconditioner
+	vector<int> m_conVar; // variable fixed by each constraint row
+	vector<QPScalarType> m_conCoeff;
+	int m_variableBounds;
+	int m_maxIter, m_maxCGIter;
+	double m_tol, m_cgTol, m_searchTol;
+};
+
+class CGSession : public QPsession
+{
+public:
+	CGSession(const CGInterface &cg, QPinterface::LOGtype logtype) : m_cg(cg), m_logtype(logtype) {}
+	virtual ~CGSession() {}
+
+	// X0 is the starting point of the iterations, its variables lying on a bound start out fixed to it.
+	// Returns false if the active set has not settled or its last CG solve has not reached cgTol
+	virtual bool solve(QPVectorX &X, const QPVectorX &b, const QPVectorX *X0 = NULL);
+
+protected:
+	enum VarState { FREE, LOWER, UPPER, KNOWN };
+
+	// CG on the free variables from the current X, returns the number of iterations;
+	// reached: the relative residual got below cgTol (not on the iteration cap or a breakdown)
+	int solveFree(QPVectorX &X, const vector<char> &state, double cgTol, bool &reached);
+	// z = M^-1 r, zero outside the free variables (Jacobi)
+	virtual void precondition(const QPVectorX &r, QPVectorX &z, const vector<char> &state);
+
+	const CGInterface & m_cg;
+	QPinterface::LOGtype m_logtype;
+	QPVectorX m_r, m_z, m_p, m_q; // CG work vectors
+};
+
+#endif // __CGInterface_H__
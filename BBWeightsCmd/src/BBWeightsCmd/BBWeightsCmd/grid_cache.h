@@ -0,0 +1,62 @@
+// Grids of the last meshes bbwSolver ran on, so that another run on the same mesh (e.g. with another
+// skeleton) skips the voxelization and the construction of the grid.
+
+#ifndef __GRIDCACHE_H__
+#define __GRIDCACHE_H__
+
+#include "BoxGrid.h"
+#include <stdint.h>
+
+// keyed by a hash of the mesh and the grid options; owns the grids and drops the least recently used
+// one beyond the capacity (0 disables the cache)
+class GridCache
+{
+public:
+	GridCache(int capacity = 2) : m_capacity(capacity), m_clock(0) {}
+	~GridCache() { clear(); }
+
+	BoxGrid * find(uint64_t key) {
+		for (unsigned int i = 0; i < m_entries.size(); ++i) {
+			if (m_entries[i].key == key) {
+				m_entries[i].lastUse = ++m_clock;
+				return m_entries[i].grid;
+			}
+		}
+		return NULL;
+	}
+	// the cache takes the grid over; returns false (and the caller keeps it) if the cache is disabled
+	bool insert(uint64_t key, BoxGrid * grid) {
+		if (m_capacity <= 0) return false;
+		while ((int)m_entries.size() >= m_capacity) evict();
+		Entry e = { key, grid, ++m_clock };
+		m_entries.push_back(e);
+		return true;
+	}
+	void setCapacity(int capacity) {
+		m_capacity = capacity;
+		while ((int)m_entries.size() > max(0, m_capacity)) evict();
+	}
+	void clear() {
+		for (unsigned int i = 0; i < m_entries.size(); ++i) delete m_entries[i].grid;
+		m_entries.clear();
+	}
+
+private:
+	void evict() {
+		unsigned int oldest = 0;
+		for (unsigned int i = 1; i < m_entries.size(); ++i) if (m_entries[i].lastUse < m_entries[oldest].lastUse) oldest = i;
+		delete m_entries[oldest].grid;
+		m_entries.erase(m_entries.begin() + oldest);
+	}
+
+	struct Entry {
+		uint64_t key;
+		BoxGrid * grid;
+		unsigned long lastUse;
+	};
+	vector<Entry> m_entries;
+	int m_capacity;
+	unsigned long m_clock;
+};
+
+#endif // __GRIDCACHE_H__
@@ -0,0 +1,157 @@
+#include "mg_solver.h"
+
+MGInterface::MGInterface()
+{
+	m_maxLevels = 10;
+	m_degree = 3;
+}
+
+MGInterface::~MGInterface()
+{
+}
+
+// largest eigenvalue of D^-1 A by power iteration, with a safety margin. Holding variables at zero only
+// lowers it, so the bound holds for every active set.
+static QPScalarType estimateLambdaMax(const QPoperator &op, const QPVectorX &invDiag)
+{
+	const int N = op.size();
+	QPVectorX x(N), y;
+	for (int i = 0; i < N; ++i) x[i] = 1.0 + ((i * 7919) % 13) / 13.0; // not smooth
+	QPScalarType lambda = 1;
+	for (int k = 0; k < 20; ++k) {
+		x.normalize();
+		op.apply(x, y);
+		y = invDiag.cwiseProduct(y);
+		lambda = x.dot(y);
+		x = y;
+	}
+	return 1.1 * lambda;
+}
+
+bool MGInterface::setupOperator(const QPoperator &Q, const QPSparseMatrix &A, int variableBounds)
+{
+	if (!CGInterface::setupOperator(Q, A, variableBounds)) return false;
+	m_levels.clear();
+	if (Q.coarser() == NULL) {
+		cout << "mg: no grid hierarchy, Jacobi preconditioning" << endl;
+		return true;
+	}
+	for (const QPoperator * op = &Q; op != NULL; op = op->coarser()) {
+		Level level;
+		level.op = op;
+		op->diagonal(level.invDiag);
+		for (int i = 0; i < level.invDiag.rows(); ++i) level.invDiag[i] = (level.invDiag[i] > 0) ? 1.0 / level.invDiag[i] : 1.0;
+		level.lambdaMax = estimateLambdaMax(*op, level.invDiag);
+		if (op->coarser() != NULL) op->restrictTo(QPVectorX::Ones(op->size()), level.weight);
+		m_levels.push_back(level);
+	}
+	return true;
+}
+
+QPsession * MGInterface::createSession(LOGtype logtype, int /*numThreads*/) const
+{
+	return new MGSession(*this, logtype);
+}
+
+MGSession::MGSession(const MGInterface &mg, QPinterface::LOGtype logtype) : CGSession(mg, logtype), m_mg(mg)
+{
+	const int L = mg.m_levels.size();
+	m_xf.resize(L);
+	m_res.resize(L);
+	m_d.resize(L);
+	m_Ad.resize(L);
+	m_rc.resize(L);
+	m_zc.resize(L);
+}
+
+void MGSession::updateMasks(const vector<char> &state)
+{
+	const int N = state.size();
+	bool changed = m_free.empty();
+	for (int i = 0; i < N && !changed; ++i) changed = (m_free[0][i] != (state[i] == FREE));
+	if (!changed) return;
+	const int numLevels = m_mg.m_levels.size();
+	m_free.resize(numLevels);
+	m_free[0].resize(N);
+	for (int i = 0; i < N; ++i) m_free[0][i] = (state[i] == FREE);
+	// a coarse node is held when more than half of its prolongation weight goes to held nodes
+	for (int l = 0; l + 1 < numLevels; ++l) {
+		const MGInterface::Level & L = m_mg.m_levels[l];
+		QPVectorX held(L.op->size()), coarseHeld;
+		for (int i = 0; i < L.op->size(); ++i) held[i] = m_free[l][i] ? 0 : 1;
+		L.op->restrictTo(held, coarseHeld);
+		m_free[l + 1].resize(coarseHeld.rows());
+		for (int i = 0; i < coarseHeld.rows(); ++i) m_free[l + 1][i] = (coarseHeld[i] <= 0.5 * L.weight[i]);
+	}
+}
+
+void MGSession::applyMasked(int level, const QPVectorX &x, QPVectorX &y)
+{
+	const vector<char> & free = m_free[level];
+	const int N = x.rows();
+	QPVectorX & xf = m_xf[level];
+	xf = x;
+	for (int i = 0; i < N; ++i) if (!free[i]) xf[i] = 0;
+	m_mg.m_levels[level].op->apply(xf, y);
+	for (int i = 0; i < N; ++i) if (!free[i]) y[i] = x[i];
+}
+
+void MGSession::smooth(int level, const QPVectorX &r, QPVectorX &z, int degree)
+{
+	const MGInterface::Level & L = m_mg.m_levels[level];
+	const vector<char> & free = m_free[level];
+	const int N = r.rows();
+	QPVectorX & res = m_res[level];
+	QPVectorX & Ad = m_Ad[level];
+	QPVectorX & d = m_d[level];
+	d.resize(N);
+	// Chebyshev polynomial of D^-1 A damping the eigenvalues in [lambdaMax / 30, lambdaMax]
+	const QPScalarType b = L.lambdaMax, a = b / 30;
+	const QPScalarType theta = (a + b) / 2, delta = (b - a) / 2, sigma = theta / delta;
+	QPScalarType rho = 1 / sigma;
+	applyMasked(level, z, Ad);
+	res = r - Ad;
+	for (int i = 0; i < N; ++i) d[i] = free[i] ? L.invDiag[i] * res[i] / theta : 0;
+	for (int k = 0; k < degree; ++k) {
+		z += d;
+		if (k == degree - 1) break;
+		applyMasked(level, d, Ad);
+		res -= Ad;
+		const QPScalarType rhoNew = 1 / (2 * sigma - rho);
+		for (int i = 0; i < N; ++i) d[i] = free[i] ? rhoNew * rho * d[i] + 2 * rhoNew / delta * L.invDiag[i] * res[i] : 0;
+		rho = rhoNew;
+	}
+}
+
+// symmetric V-cycle from z = 0, so that it can precondition CG
+void MGSession::vcycle(int level, const QPVectorX &r, QPVectorX &z)
+{
+	z.setZero(r.rows());
+	if (level == (int)m_mg.m_levels.size() - 1) {
+		smooth(level, r, z, 8 * m_mg.m_degree);
+		return;
+	}
+	const MGInterface::Level & L = m_mg.m_levels[level];
+	smooth(level, r, z, m_mg.m_degree);
+	// coarse correction of the residual
+	QPVectorX & res = m_res[level];
+	QPVectorX & rc = m_rc[level];
+	applyMasked(level, z, m_Ad[level]);
+	res = r - m_Ad[level];
+	L.op->restrictTo(res, rc);
+	for (int i = 0; i < rc.rows(); ++i) if (!m_free[level + 1][i]) rc[i] = 0;
+	vcycle(level + 1, rc, m_zc[level]);
+	L.op->prolongate(m_zc[level], m_Ad[level]);
+	for (int i = 0; i < z.rows(); ++i) if (m_free[level][i]) z[i] += m_Ad[level][i];
+	smooth(level, r, z, m_mg.m_degree);
+}
+
+void MGSession::precondition(const QPVectorX &r, QPVectorX &z, const vector<char> &state)
+{
+	if (m_mg.m_levels.empty()) {
+		CGSession::precondition(r, z, state);
+		return;
+	}
+	updateMasks(state);
+	vcycle(0, r, z);
+}
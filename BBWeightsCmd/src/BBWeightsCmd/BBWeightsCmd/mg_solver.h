@@ -0,0 +1,62 @@
+// Built-in matrix-free bounded QP solver with a geometric multigrid preconditioner
+
+#ifndef __MGInterface_H__
+#define __MGInterface_H__
+
+#include "cg_solver.h"
+
+// Same active-set iteration as CGInterface, with the CG on the free variables preconditioned by a multigrid
+// V-cycle over the grid hierarchy of the operator (QPoperator::coarser): Chebyshev-Jacobi smoothing on every
+// level, the variables that are not free held at zero on the finest level and the coarse nodes mostly
+// interpolated from held ones held on the coarser levels. The CG iteration counts hardly grow with the
+// resolution. Without a hierarchy (e.g. set up from a matrix) it falls back to the Jacobi preconditioner.
+class MGInterface : public CGInterface
+{
+public:
+	MGInterface();
+	virtual ~MGInterface();
+
+	virtual bool setupOperator(const QPoperator &Q, const QPSparseMatrix &A, int variableBounds);
+	virtual int hierarchyLevels() const { return m_maxLevels; }
+	virtual QPsession * createSession(LOGtype logtype, int numThreads) const;
+
+	// smoothing steps before and after the coarse correction (8 times as many on the coarsest level)
+	void setSmoothing(int degree) { m_degree = max(1, degree); }
+
+private:
+	friend class MGSession;
+
+	struct Level {
+		const QPoperator * op;
+		QPVectorX invDiag;
+		QPScalarType lambdaMax; // bound of the eigenvalues of D^-1 A
+		QPVectorX weight; // P'1: sum of the prolongation weights of each node of the next coarser level
+	};
+	vector<Level> m_levels; // finest first
+	int m_maxLevels, m_degree;
+};
+
+class MGSession : public CGSession
+{
+public:
+	MGSession(const MGInterface &mg, QPinterface::LOGtype logtype);
+	virtual ~MGSession() {}
+
+protected:
+	virtual void precondition(const QPVectorX &r, QPVectorX &z, const vector<char> &state);
+
+private:
+	// the variables held on every level, updated when the active set changes
+	void updateMasks(const vector<char> &state);
+	// y = A x on the free variables of the level, y = x on the held ones
+	void applyMasked(int level, const QPVectorX &x, QPVectorX &y);
+	// degree Chebyshev iterations on A z = r from z
+	void smooth(int level, const QPVectorX &r, QPVectorX &z, int degree);
+	void vcycle(int level, const QPVectorX &r, QPVectorX &z);
+
+	const MGInterface & m_mg;
+	vector<vector<char> > m_free; // per level
+	vector<QPVectorX> m_xf, m_res, m_d, m_Ad, m_rc, m_zc; // per level work vectors
+};
+
+#endif // __MGInterface_H__
@@ -1,6 +1,7 @@
 #include "mosek_solver.h"
 
 #include "utils_functions.h"
+#include "STL_inc.h"
 
 static void MSKAPI printstr(void *handle,
 	MSKCONST char str[])
@@ -10,6 +11,11 @@ static void MSKAPI printstr(void *handle,
 
 MOSEKinterface::MOSEKinterface()
 {
+	m_numCon = m_numVar = 0;
+	m_QnumEl = m_AnumEl = 0;
+	m_Qsubi = m_Qsubj = m_Asubi = m_Asubj = NULL;
+	m_Qval = m_Aval = NULL;
+	m_variableBounds = 1;
 	MSKrescodee   r;
 	r = MSK_makeenv(&m_env, NULL);
 	r = MSK_initenv(m_env);
@@ -18,6 +24,7 @@ MOSEKinterface::MOSEKinterface()
 
 MOSEKinterface::~MOSEKinterface()
 {
+	releaseQP();
 	MSK_deleteenv(&m_env);
 }
 
@@ -93,7 +100,7 @@ MSK_GUARDED(MSK_putintparam(task,MSK_IPAR_DATA_CHECK,MSK_OFF));
 }*/
 
 
-bool MOSEKinterface::solveQP_BBW_type(VectorX &X, const SparseMatrix &Q, const MatrixXX &C, const SparseMatrix &A, const VectorX &b, int variableBounds, LOGtype logtype)
+bool MOSEKinterface::solveQP_BBW_type(QPVectorX &X, const QPSparseMatrix &Q, const QPMatrixXX &C, const QPSparseMatrix &A, const QPVectorX &b, int variableBounds, LOGtype logtype, int numThreads)
 {
 	const int NUMCON = A.rows();
 	const int NUMVAR = A.cols();
@@ -107,7 +114,7 @@ bool MOSEKinterface::solveQP_BBW_type(VectorX &X, const SparseMatrix &Q, const M
 	MSKrescodee   r;
 	r = MSK_maketask(m_env, NUMCON, NUMVAR, &task);
 
-	r = MSK_putintparam(task, MSK_IPAR_NUM_THREADS, 4);
+	r = MSK_putintparam(task, MSK_IPAR_NUM_THREADS, numThreads);
 	r = MSK_putintparam(task, MSK_IPAR_CHECK_CONVEXITY, MSK_CHECK_CONVEXITY_SIMPLE);
 
 	if (logtype == PRINT_LOG) r = MSK_linkfunctotaskstream(task, MSK_STREAM_LOG, NULL, printstr);
@@ -144,7 +151,7 @@ bool MOSEKinterface::solveQP_BBW_type(VectorX &X, const SparseMatrix &Q, const M
 	//alecsMosekParameters(task);
 
 	X.setZero(NUMVAR, NUMRHS);
-	MatrixXX sol(NUMVAR, 1);
+	QPMatrixXX sol(NUMVAR, 1);
 	for (int i = 0; i<NUMRHS; i++)
 	{
 		for (int j = 0; j<NUMVAR; j++) r = MSK_putcj(task, j, C(j, i));
@@ -168,6 +175,7 @@ bool MOSEKinterface::solveQP_BBW_type(VectorX &X, const SparseMatrix &Q, const M
 		if (solsta != MSK_SOL_STA_OPTIMAL && solsta != MSK_SOL_STA_NEAR_OPTIMAL)
 		{
 			printf("solveQP failed\n");
+			MSK_deletetask(&task);
 			return false;
 		}
 
@@ -177,5 +185,110 @@ bool MOSEKinterface::solveQP_BBW_type(VectorX &X, const SparseMatrix &Q, const M
 
 		delete[] solValue;
 	}
+	MSK_deletetask(&task);
 	return true;
-}
\ No newline at end of file
+}
+
+void MOSEKinterface::setupQP_BBW_type(const QPSparseMatrix &Q, const QPSparseMatrix &A, int variableBounds)
+{
+	assert(Q.rows() == A.cols() && Q.cols() == A.cols());
+	releaseQP();
+	m_numCon = A.rows();
+	m_numVar = A.cols();
+	m_variableBounds = variableBounds;
+
+	convertSparseMatrixToBuffer(Q, true, m_QnumEl, m_Qsubi, m_Qsubj, m_Qval);
+	for (int i = 0; i<m_QnumEl; i++) m_Qval[i] *= 2.0;
+	convertSparseMatrixToBuffer(A, false, m_AnumEl, m_Asubi, m_Asubj, m_Aval);
+}
+
+void MOSEKinterface::releaseQP()
+{
+	delete[] m_Qsubi; delete[] m_Qsubj; delete[] m_Qval;
+	delete[] m_Asubi; delete[] m_Asubj; delete[] m_Aval;
+	m_Qsubi = m_Qsubj = m_Asubi = m_Asubj = NULL;
+	m_Qval = m_Aval = NULL;
+	m_QnumEl = m_AnumEl = 0;
+	m_numCon = m_numVar = 0;
+}
+
+QPsession * MOSEKinterface::createSession(LOGtype logtype, int numThreads) const
+{
+	return new MOSEKsession(*this, logtype, numThreads);
+}
+
+MOSEKsession::MOSEKsession(const MOSEKinterface &mi, MOSEKinterface::LOGtype logtype, int numThreads)
+{
+	m_numCon = mi.m_numCon;
+	m_numVar = mi.m_numVar;
+	m_logtype = logtype;
+	m_valid = false;
+	m_task = NULL;
+
+	MSKrescodee r = MSK_maketask(mi.m_env, m_numCon, m_numVar, &m_task);
+	if (r != MSK_RES_OK) return;
+
+	r = MSK_putintparam(m_task, MSK_IPAR_NUM_THREADS, numThreads);
+	r = MSK_putintparam(m_task, MSK_IPAR_CHECK_CONVEXITY, MSK_CHECK_CONVEXITY_SIMPLE);
+
+	if (logtype == MOSEKinterface::PRINT_LOG) r = MSK_linkfunctotaskstream(m_task, MSK_STREAM_LOG, NULL, printstr);
+	else if (logtype == MOSEKinterface::PRINT_NOTHING) r = MSK_linkfunctotaskstream(m_task, MSK_STREAM_LOG, NULL, NULL);
+	r = MSK_putmaxnumvar(m_task, m_numVar);
+	r = MSK_putmaxnumcon(m_task, m_numCon);
+	r = MSK_putmaxnumanz(m_task, mi.m_AnumEl);
+
+	r = MSK_appendcons(m_task, m_numCon);
+	r = MSK_appendvars(m_task, m_numVar);
+
+	r = MSK_putqobj(m_task, mi.m_QnumEl, mi.m_Qsubi, mi.m_Qsubj, mi.m_Qval);
+
+	vector<MSKboundkeye> bk(m_numVar);
+	vector<double> bl(m_numVar), bu(m_numVar);
+	for (int k = 0; k<m_numVar; k++)
+	{
+		if (mi.m_variableBounds == 1) { bk[k] = MSK_BK_RA; bl[k] = 0.0; bu[k] = 1.0; } // [0, 1] box constraints
+		else { bk[k] = MSK_BK_FR; bl[k] = -MSK_INFINITY; bu[k] = +MSK_INFINITY; } // need to explicitly tell MOSEK that we want NO bounds on *variables*
+	}
+	if (m_numVar > 0) r = MSK_putboundslice(m_task, MSK_ACC_VAR, 0, m_numVar, &bk[0], &bl[0], &bu[0]);
+
+	r = MSK_putaijlist(m_task, mi.m_AnumEl, mi.m_Asubi, mi.m_Asubj, mi.m_Aval);
+	m_valid = (r == MSK_RES_OK);
+}
+
+MOSEKsession::~MOSEKsession()
+{
+	if (m_task != NULL) MSK_deletetask(&m_task);
+}
+
+bool MOSEKsession::solve(QPVectorX &X, const QPVectorX &b, const QPVectorX *X0)
+{
+	assert(b.rows() == m_numCon);
+	if (!m_valid) return false;
+
+	MSKrescodee r;
+	vector<MSKboundkeye> bk(m_numCon, MSK_BK_FX);
+	vector<double> bv(m_numCon);
+	for (int k = 0; k<m_numCon; k++) bv[k] = b.coeff(k);
+	if (m_numCon > 0) r = MSK_putboundslice(m_task, MSK_ACC_CON, 0, m_numCon, &bk[0], &bv[0], &bv[0]);
+
+	MSKrescodee trmcode;
+	/* Run optimizer */
+	r = MSK_optimizetrm(m_task, &trmcode);
+
+	/* Print a summary containing information about the solution for debugging purposes*/
+	if (m_logtype == MOSEKinterface::PRINT_LOG) MSK_solutionsummary(m_task, MSK_STREAM_LOG);
+
+	MSKsolstae solsta;
+	MSK_getsolsta(m_task, MSK_SOL_ITR, &solsta);
+	if (solsta != MSK_SOL_STA_OPTIMAL && solsta != MSK_SOL_STA_NEAR_OPTIMAL)
+	{
+		printf("solveQP failed\n");
+		return false;
+	}
+
+	vector<double> solValue(m_numVar);
+	MSK_getsolutionslice(m_task, MSK_SOL_ITR, MSK_SOL_ITEM_XX, 0, m_numVar, &solValue[0]);
+	X.resize(m_numVar);
+	for (int j = 0; j<m_numVar; j++) X[j] = solValue[j];
+	return true;
+}
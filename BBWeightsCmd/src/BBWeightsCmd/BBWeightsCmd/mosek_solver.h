@@ -5,22 +5,50 @@
 
 #include "mosek.h"
 
-#include "EIGEN_inc.h"
+#include "qp_solver.h"
 
-class MOSEKinterface
+class MOSEKinterface : public QPinterface
 {
 public:
 	MOSEKinterface();
 	virtual ~MOSEKinterface();
 
-	enum LOGtype { PRINT_LOG, PRINT_NOTHING };
+	bool solveQP_BBW_type(QPVectorX &X, const QPSparseMatrix &Q, const QPMatrixXX &C, const QPSparseMatrix &A, const QPVectorX &b, int variableBounds, LOGtype logtype, int numThreads = 4);
 
-	bool solveQP_BBW_type(VectorX &X, const SparseMatrix &Q, const MatrixXX &C, const SparseMatrix &A, const VectorX &b, int variableBounds, LOGtype logtype);
+	// load Q, A and the variable bounds once; the buffers are then shared by all the sessions created on this interface
+	void setupQP_BBW_type(const QPSparseMatrix &Q, const QPSparseMatrix &A, int variableBounds);
+	void releaseQP();
 
+	virtual bool setup(const QPSparseMatrix &Q, const QPSparseMatrix &A, int variableBounds) { setupQP_BBW_type(Q, A, variableBounds); return true; }
+	virtual QPsession * createSession(LOGtype logtype, int numThreads) const;
 
 private:
+	friend class MOSEKsession;
+
 	MSKenv_t    m_env;
 
+	int m_numCon, m_numVar;
+	int m_QnumEl, *m_Qsubi, *m_Qsubj; double *m_Qval;
+	int m_AnumEl, *m_Asubi, *m_Asubj; double *m_Aval;
+	int m_variableBounds;
+};
+
+// One MOSEK task built from the buffers of a set-up MOSEKinterface. Only the right-hand side b changes between solves,
+// so a session is meant to be reused for a sequence of handles (one session per thread).
+class MOSEKsession : public QPsession
+{
+public:
+	MOSEKsession(const MOSEKinterface &mi, MOSEKinterface::LOGtype logtype, int numThreads = 4);
+	virtual ~MOSEKsession();
+
+	// X0 is ignored: the interior-point optimizer MOSEK uses for QPs has no warm start
+	virtual bool solve(QPVectorX &X, const QPVectorX &b, const QPVectorX *X0 = NULL);
+
+private:
+	MSKtask_t m_task;
+	int m_numCon, m_numVar;
+	MOSEKinterface::LOGtype m_logtype;
+	bool m_valid;
 };
 
 #endif // __MOSEKinterface_H__
@@ -26,5 +26,6 @@ MStatus uninitializePlugin(MObject obj)
 
 	status = plugin.deregisterCommand("bbwSolver");
 	CHECK_MSTATUS_AND_RETURN_IT(status);
+	BBWeightsCmd::releaseGridCache();
 	return MS::kSuccess;
 }
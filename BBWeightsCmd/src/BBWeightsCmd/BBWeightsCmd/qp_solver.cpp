@@ -0,0 +1,38 @@
+#include "qp_solver.h"
+#include "activeset_solver.h"
+#include "cg_solver.h"
+#include "mg_solver.h"
+#ifndef BBW_NO_MOSEK
+#include "mosek_solver.h"
+#endif
+
+QPinterface * createQPinterface(const string &name)
+{
+#ifndef BBW_NO_MOSEK
+	if (name == "mosek") return new MOSEKinterface();
+#endif
+	if (name == "activeset") return new ActiveSetInterface();
+	if (name == "cg") return new CGInterface();
+	if (name == "mg") return new MGInterface();
+	return NULL;
+}
+
+void listQPinterfaces(vector<string> &names)
+{
+	names.clear();
+#ifndef BBW_NO_MOSEK
+	names.push_back("mosek");
+#endif
+	names.push_back("activeset");
+	names.push_back("cg");
+	names.push_back("mg");
+}
+
+string defaultQPinterface()
+{
+#ifndef BBW_NO_MOSEK
+	return "mosek";
+#else
+	return "activeset";
+#endif
+}
@@ -0,0 +1,74 @@
+// Common interface of the QP solvers used for the bounded biharmonic weights:
+//   min x'Qx  s.t.  Ax = b, 0 <= x <= 1
+// Q, A and the bounds are set up once on a QPinterface, then every thread creates its own QPsession
+// and solves it for a sequence of right-hand sides b (one per handle).
+
+#ifndef __QPinterface_H__
+#define __QPinterface_H__
+
+#include "EIGEN_inc.h"
+#include "STL_inc.h"
+
+// Q given as an operator y = Qx instead of an explicit matrix, for the solvers that only need products
+class QPoperator
+{
+public:
+	virtual ~QPoperator() {}
+
+	virtual int size() const = 0;
+	virtual void apply(const QPVectorX &x, QPVectorX &y) const = 0;
+	virtual void diagonal(QPVectorX &d) const = 0;
+
+	// grid hierarchy for the multigrid solvers: the operator of the next coarser grid (NULL if none),
+	// the prolongation x = P xc from it and the restriction xc = P'x to it
+	virtual const QPoperator * coarser() const { return NULL; }
+	virtual void prolongate(const QPVectorX & /*xc*/, QPVectorX & /*x*/) const {}
+	virtual void restrictTo(const QPVectorX & /*x*/, QPVectorX & /*xc*/) const {}
+};
+
+// explicit matrix seen as an operator (the matrix must outlive it)
+class SparseQPoperator : public QPoperator
+{
+public:
+	SparseQPoperator(const QPSparseMatrix &Q) : m_Q(Q) {}
+
+	virtual int size() const { return m_Q.rows(); }
+	virtual void apply(const QPVectorX &x, QPVectorX &y) const { y = m_Q * x; }
+	virtual void diagonal(QPVectorX &d) const { d = m_Q.diagonal(); }
+
+private:
+	const QPSparseMatrix & m_Q;
+};
+
+class QPsession
+{
+public:
+	virtual ~QPsession() {}
+
+	// X0 is an optional starting point (e.g. the previous solution), ignored by solvers that cannot warm start
+	virtual bool solve(QPVectorX &X, const QPVectorX &b, const QPVectorX *X0 = NULL) = 0;
+};
+
+class QPinterface
+{
+public:
+	virtual ~QPinterface() {}
+
+	enum LOGtype { PRINT_LOG, PRINT_NOTHING };
+
+	// variableBounds 1: [0, 1] box constraints, else just biharmonic
+	virtual bool setup(const QPSparseMatrix &Q, const QPSparseMatrix &A, int variableBounds) = 0;
+	// matrix-free solvers can be set up from an operator (which must outlive the sessions) and never need Q itself
+	virtual bool isMatrixFree() const { return false; }
+	virtual bool setupOperator(const QPoperator & /*Q*/, const QPSparseMatrix & /*A*/, int /*variableBounds*/) { return false; }
+	// coarser levels the operator should come with (multigrid solvers)
+	virtual int hierarchyLevels() const { return 0; }
+	virtual QPsession * createSession(LOGtype logtype, int numThreads) const = 0;
+};
+
+// "mosek" (unless built with BBW_NO_MOSEK), "activeset", "cg" or "mg" (matrix-free); returns NULL for an unknown name
+QPinterface * createQPinterface(const string &name);
+void listQPinterfaces(vector<string> &names);
+string defaultQPinterface();
+
+#endif // __QPinterface_H__
@@ -6,15 +6,73 @@
 #include "Array3D.h"
 #include "STL_inc.h"
 #include "BoxGrid.h"
+#include "Voxelizer.h"
+#include "VoxelizerMaya.h"
+#include "bbw_core.h"
 
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
 
-void compute(BoxGrid& voxGrid, map<string, RowVector3> B, map<string, string> boneWise)
+bool compute(BoxGrid& voxGrid, map<string, RowVector3> B, map<string, string> boneWise)
 {
-	voxGrid.computeBoneBBW(B, boneWise);
+	return voxGrid.computeBoneBBW(B, boneWise);
 }
 
-bool Voxelize(const MFnMesh& mesh, int resX, int resY, int resZ, MPointArray& voxels, Array3D<int>& m_voxArray)
+// solves the same BoxGrid with every available QP backend, reports timings and the largest weight difference to the first one
+void benchmarkSolvers(BoxGrid& voxGrid, map<string, RowVector3> B, map<string, string> boneWise)
+{
+	vector<string> names;
+	listQPinterfaces(names);
+	const int N = voxGrid.getNumNodes();
+	const int M = B.size();
+	MatrixXX reference;
+	for (unsigned int s = 0; s < names.size(); s++)
+	{
+		voxGrid.setSolver(names[s]);
+		MTimer timer; timer.beginTimer();
+		voxGrid.computeBoneBBW(B, boneWise);
+		timer.endTimer();
+		MatrixXX W(N, M);
+		for (int i = 0; i < N; i++)
+			for (int j = 0; j < M; j++) W(i, j) = voxGrid.getWeight(j, i);
+		if (s == 0) reference = W;
+		printf("BBW Benchmark: %-10s %d nodes, %d handles: %fs, max |w - w_%s| = %g\n", names[s].c_str(), N, M, timer.elapsedTime(),
+			names[0].c_str(), (W - reference).cwiseAbs().maxCoeff());
+	}
+}
+
+// assembly of the biharmonic matrix on solid cubes: triplets + sparse product against the direct stencil assembly
+void benchmarkAssembly()
+{
+	const int resolutions[] = { 16, 32, 64, 96 };
+	for (int r = 0; r < 4; r++)
+	{
+		const int res = resolutions[r];
+		Array3D<bool> cube(res, res, res);
+		cube.setAllTo(true);
+		BoxGrid grid;
+		grid.initVoxels(res, cube);
+		grid.initStructure();
+		const int N = grid.getNumNodes();
+		MTimer timer; timer.beginTimer();
+		vector<QPSparseMatrixTriplet> L_MEL;
+		grid.laplacianMEL(L_MEL);
+		QPSparseMatrix L(N, N);
+		L.setFromTriplets(L_MEL.begin(), L_MEL.end());
+		QPSparseMatrix reference = L*L;
+		timer.endTimer();
+		const double tripletTime = timer.elapsedTime();
+		timer.beginTimer();
+		QPSparseMatrix L2;
+		grid.laplacian(L);
+		BoxGrid::bilaplacian(L, L2);
+		timer.endTimer();
+		const QPSparseMatrix diff = reference - L2;
+		printf("BBW Benchmark: biharmonic assembly %d^3 (%d nodes, %d nonzeros): triplets %fs, stencil %fs, max diff %g\n", res, N, (int)L2.nonZeros(),
+			tripletTime, timer.elapsedTime(), diff.coeffs().cwiseAbs().maxCoeff());
+	}
+}
+
+bool Voxelize(const MFnMesh& mesh, int resX, int resY, int resZ, MPointArray& voxels, Array3D<bool>& m_voxArray)
 {
 	// This method is an implementation of the paper "Single-Pass GPU Solid 
 	// Voxelization for Real-Time Applications"
@@ -371,7 +429,7 @@ bool Voxelize(const MFnMesh& mesh, int resX, int resY, int resZ, MPointArray& vo
 							bbMax += halfVoxel;
 							voxels.append(bbMin);
 							voxels.append(bbMax);
-							m_voxArray(x, y, resZ - (32 * (3 - i) + z)) = 1;
+							m_voxArray.set(x, y, resZ - 1 - (32 * (3 - i) + z), true);
 						}
 					}
 				}
@@ -408,6 +466,45 @@ bool Voxelize(const MFnMesh& mesh, int resX, int resY, int resZ, MPointArray& vo
 	return true;
 }
 
+// Voxelization of bbwSolver, the same as the bbw tool's: the packed vertices (UnitPacking) over the unit cube the
+// grid is defined on, plus the voxels holding a vertex
+bool VoxelizePacked(const MFnMesh& mesh, const PointMatrixType& vertices, int res, Array3D<bool>& voxArray)
+{
+	MIntArray triangleCounts, triVertices;
+	mesh.getTriangles(triangleCounts, triVertices);
+	vector<int> triangles(triVertices.length());
+	for (unsigned int i = 0; i < triVertices.length(); i++) triangles[i] = triVertices[i];
+	return VoxelizeUnitCube(vertices, triangles, res, voxArray);
+}
+
+// Same input and output as Voxelize (voxels over the raw mesh bounding box, not the packed unit cube),
+// computed on the CPU: kept to compare against the GL path
+bool VoxelizeCPU(const MFnMesh& mesh, int resX, int resY, int resZ, MPointArray& voxels, Array3D<bool>& m_voxArray)
+{
+	return VoxelizeMeshCPU(mesh, resX, resY, resZ, voxels, m_voxArray);
+}
+
+// times both voxelizers on the same mesh and counts the voxels where they disagree
+void benchmarkVoxelizers(const MFnMesh& mesh, int res)
+{
+	MPointArray voxels;
+	Array3D<bool> cpuVox(res, res, res), glVox(res, res, res);
+	MTimer timer; timer.beginTimer();
+	VoxelizeCPU(mesh, res, res, res, voxels, cpuVox);
+	timer.endTimer();
+	printf("BBW Benchmark: cpu voxelizer %d^3: %fs, %u voxels\n", res, timer.elapsedTime(), voxels.length() / 2);
+	if (MGlobal::mayaState() != MGlobal::kInteractive || res > 128) return; // no GL context, or beyond the GL limit
+	timer.beginTimer();
+	Voxelize(mesh, res, res, res, voxels, glVox);
+	timer.endTimer();
+	int diff = 0;
+	for (int x = 0; x < res; x++)
+		for (int y = 0; y < res; y++)
+			for (int z = 0; z < res; z++)
+				if (cpuVox(x, y, z) != glVox(x, y, z)) diff++;
+	printf("BBW Benchmark: gl voxelizer %d^3: %fs, %u voxels, %d differ from cpu\n", res, timer.elapsedTime(), voxels.length() / 2, diff);
+}
+
 void UnitPacking(const MFnMesh& fnMesh, PointMatrixType& vertices, RowVector3& bmin, RowVector3& bmax,
 	ScalarType& scale, RowVector3& center)
 {
@@ -418,19 +515,7 @@ void UnitPacking(const MFnMesh& fnMesh, PointMatrixType& vertices, RowVector3& b
 		RowVector3 v(points[i].x, points[i].y, points[i].z);
 		vertices.row(i) = v;
 	}
-	size_t nbV = vertices.rows();
-	bmin = bmax = vertices.row(0);
-	for (int i = 1; i < nbV; i++) {
-		bmin = bmin.cwiseMin(vertices.row(i));
-		bmax = bmax.cwiseMax(vertices.row(i));
-	}
-	RowVector3 length = (bmax - bmin).cwiseInverse();
-	ScalarType min_scale = 0.95*length.minCoeff();
-	scale = min_scale;
-	center = (bmin + bmax) / 2.0;
-	for (int i = 0; i < nbV; i++) {
-		vertices.row(i) = min_scale*(vertices.row(i) - center) + RowVector3(0.5, 0.5, 0.5);
-	}
+	UnitPacking(vertices, bmin, bmax, scale, center);
 }
 
 #endif
\ No newline at end of file
@@ -1,9 +1,9 @@
 #include "EIGEN_inc.h"
 
-inline void convertSparseMatrixToBuffer(const SparseMatrix & A, bool symmetric, int & AnumEl, int * & Asubi, int * & Asubj, double * & Aval) {
+inline void convertSparseMatrixToBuffer(const QPSparseMatrix & A, bool symmetric, int & AnumEl, int * & Asubi, int * & Asubj, double * & Aval) {
 	AnumEl = 0;
 	for (int k = 0; k<A.outerSize(); ++k) {
-		for (SparseMatrix::InnerIterator it(A, k); it; ++it) {
+		for (QPSparseMatrix::InnerIterator it(A, k); it; ++it) {
 			if (!symmetric || it.row() >= it.col()) AnumEl++;
 		}
 	}
@@ -14,7 +14,7 @@ inline void convertSparseMatrixToBuffer(const SparseMatrix & A, bool symmetric,
 
 	int id = 0;
 	for (int k = 0; k<A.outerSize(); ++k) {
-		for (SparseMatrix::InnerIterator it(A, k); it; ++it) {
+		for (QPSparseMatrix::InnerIterator it(A, k); it; ++it) {
 			if (!symmetric || it.row() >= it.col()) {
 				Asubi[id] = it.row();
 				Asubj[id] = it.col();
@@ -134,9 +134,11 @@ class FnSkinCluster(object):
         influenceIndices = om.MIntArray()
         [influenceIndices.append(self.getPhysicalInfluenceIndex(inf)) for inf in data.getInfluences()]
 
-        # Construct weights
-        weights = om.MDoubleArray()
-        [weights.append(w) for w in data.getWeights()]
+        # Construct weights, copied in bulk rather than appended one by one
+        values = list(data.getWeights())
+        util = om.MScriptUtil()
+        util.createFromList(values, len(values))
+        weights = om.MDoubleArray(util.asDoublePtr(), len(values))
         oldValues = om.MDoubleArray()
         self.fn.getWeights(dagPath, components, influenceIndices, oldValues)
 